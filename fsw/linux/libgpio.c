@@ -16,8 +16,84 @@ ivv-itc@lists.nasa.gov
 */
 
 #include "libgpio.h"
+#include <string.h>
+#include <poll.h>
+#include <linux/gpio.h>
 
-int32_t gpio_init(gpio_info_t* device) 
+#ifdef GPIO_V2_GET_LINE_IOCTL
+/* Request lines from a gpiochip, the returned line request fd is used for all later accesses */
+static int32_t gpio_chardev_request(uint32_t chip, const uint32_t* offsets, uint32_t count, uint8_t direction, uint64_t values, 
+                                    uint8_t edge, uint32_t debounce_us, int32_t* handle)
+{
+    struct gpio_v2_line_request req;
+    char     buffer[32];
+    int32_t  status = GPIO_SUCCESS;
+    int      fd;
+    uint32_t i;
+
+    if ((count == 0) || (count > GPIO_V2_LINES_MAX))
+    {
+        return GPIO_ERROR;
+    }
+
+    snprintf(buffer, sizeof(buffer), "/dev/gpiochip%u", chip);
+    fd = open(buffer, O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return GPIO_FD_OPEN_ERR;
+    }
+
+    memset(&req, 0, sizeof(req));
+    for (i = 0; i < count; i++)
+    {
+        req.offsets[i] = offsets[i];
+    }
+    req.num_lines = count;
+    strncpy(req.consumer, GPIO_CONSUMER, sizeof(req.consumer) - 1);
+
+    if (direction == GPIO_INPUT)
+    {
+        req.config.flags = GPIO_V2_LINE_FLAG_INPUT;
+        if (edge & GPIO_EDGE_RISING)
+        {
+            req.config.flags |= GPIO_V2_LINE_FLAG_EDGE_RISING;
+        }
+        if (edge & GPIO_EDGE_FALLING)
+        {
+            req.config.flags |= GPIO_V2_LINE_FLAG_EDGE_FALLING;
+        }
+        if ((edge != GPIO_EDGE_NONE) && (debounce_us != 0))
+        {
+            req.config.num_attrs = 1;
+            req.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_DEBOUNCE;
+            req.config.attrs[0].attr.debounce_period_us = debounce_us;
+            req.config.attrs[0].mask = (count == 64) ? ~0ULL : ((1ULL << count) - 1);
+        }
+    }
+    else
+    {
+        req.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+        req.config.num_attrs = 1;
+        req.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+        req.config.attrs[0].attr.values = values;
+        req.config.attrs[0].mask = (count == 64) ? ~0ULL : ((1ULL << count) - 1);
+    }
+
+    if (ioctl(fd, GPIO_V2_GET_LINE_IOCTL, &req) < 0)
+    {
+        status = GPIO_FD_OPEN_ERR;
+    }
+    else
+    {
+        *handle = req.fd;
+    }
+
+    close(fd);
+    return status;
+}
+#endif
+
+static int32_t gpio_sysfs_init(gpio_info_t* device) 
 {    
     char buffer[128];
     int  bytes_written;
@@ -53,27 +129,56 @@ int32_t gpio_init(gpio_info_t* device)
 
     if (device->direction == GPIO_INPUT)
     {
-        snprintf(buffer, 128, "IN");
-        bytes_written = write(fd, buffer, 4);
+        write_size = snprintf(buffer, 128, "in");
     }
     else
     {
-        snprintf(buffer, 128, "OUT");
-        bytes_written = write(fd, buffer, 4);
+        write_size = snprintf(buffer, 128, "out");
     }
+    bytes_written = write(fd, buffer, write_size);
     close(fd);
+    if (bytes_written < write_size) 
+    {
+        return GPIO_WRITE_ERR;
+    }
+
+    // Hold the value file open, accesses are then a single pread/pwrite
+    snprintf(buffer, 128, "/sys/class/gpio/gpio%d/value", device->pin);
+    fd = open(buffer, (device->direction == GPIO_INPUT) ? O_RDONLY : O_RDWR);
+    if (fd < 0) 
+    {
+        return GPIO_FD_OPEN_ERR;
+    }
+    device->handle = fd;
 
     // Set open
     device->isOpen = GPIO_OPEN;
     return GPIO_SUCCESS;
 }
 
+int32_t gpio_init(gpio_info_t* device) 
+{
+    // The character device is opt-in, there pin is a line offset on chip rather than a sysfs number
+    if (device->interface == GPIO_IF_CHARDEV)
+    {
+#ifdef GPIO_V2_GET_LINE_IOCTL
+        if (gpio_chardev_request(device->chip, &device->pin, 1, device->direction, 0, 
+                                 device->edge, device->debounce_us, &device->handle) == GPIO_SUCCESS)
+        {
+            device->isOpen = GPIO_OPEN;
+            return GPIO_SUCCESS;
+        }
+#endif
+        return GPIO_FD_OPEN_ERR;
+    }
+
+    return gpio_sysfs_init(device);
+}
+
 int32_t gpio_read(gpio_info_t* device, uint8_t* value)
 {
     int32_t status = GPIO_SUCCESS;
-    char buffer[128];
     char readValue[3];
-    int fd;
 
     if(device->isOpen != GPIO_OPEN) 
     {
@@ -81,14 +186,21 @@ int32_t gpio_read(gpio_info_t* device, uint8_t* value)
         return status;
     }
 
-    snprintf(buffer, 128, "/sys/class/gpio/gpio%d/value", device->pin);
-    fd = open(buffer, O_RDONLY);
-    if (fd < 0) 
+#ifdef GPIO_V2_GET_LINE_IOCTL
+    if (device->interface == GPIO_IF_CHARDEV)
     {
-        status = GPIO_FD_OPEN_ERR;
+        struct gpio_v2_line_values values = { .bits = 0, .mask = 1 };
+
+        if (ioctl(device->handle, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0)
+        {
+            return GPIO_READ_ERR;
+        }
+        *value = (uint8_t) (values.bits & 1);
         return status;
     }
-    if (read(fd, &readValue, 3) < 0) 
+#endif
+
+    if (pread(device->handle, readValue, sizeof(readValue), 0) < 1) 
     {
         status = GPIO_READ_ERR;
         return status;
@@ -101,15 +213,30 @@ int32_t gpio_read(gpio_info_t* device, uint8_t* value)
         *value = 0;
     }
 
-    close(fd);
     return status;
 }
 
 int32_t gpio_write(gpio_info_t* device, uint8_t value)
 {
-    char buffer[128];
     char charVal;
-    int fd;
+
+    if (device->isOpen != GPIO_OPEN) 
+    {
+        return GPIO_WRITE_ERR;
+    }
+
+#ifdef GPIO_V2_GET_LINE_IOCTL
+    if (device->interface == GPIO_IF_CHARDEV)
+    {
+        struct gpio_v2_line_values values = { .bits = (value == 1) ? 1 : 0, .mask = 1 };
+
+        if (ioctl(device->handle, GPIO_V2_LINE_SET_VALUES_IOCTL, &values) < 0)
+        {
+            return GPIO_WRITE_ERR;
+        }
+        return GPIO_SUCCESS;
+    }
+#endif
 
     if (value == 1) 
     {
@@ -120,19 +247,11 @@ int32_t gpio_write(gpio_info_t* device, uint8_t value)
         charVal = '0';
     }
 
-    snprintf(buffer, 128, "/sys/class/gpio/gpio%d/value", device->pin);
-    fd = open(buffer, O_WRONLY);
-    if (fd < 0) 
-    {
-         return GPIO_FD_OPEN_ERR;
-    }
-
-    if (write(fd, &charVal, 1) != 1) 
+    if (pwrite(device->handle, &charVal, 1, 0) != 1) 
     {
         return GPIO_WRITE_ERR;
     }
 
-    close(fd);
     return GPIO_SUCCESS;
 }
 
@@ -143,8 +262,19 @@ int32_t gpio_close(gpio_info_t* device)
     int  write_size;
     int  fd;
     
+#ifdef GPIO_V2_GET_LINE_IOCTL
+    if ((device->isOpen == GPIO_OPEN) && (device->interface == GPIO_IF_CHARDEV))
+    {   // Release the line request
+        close(device->handle);
+        device->isOpen = GPIO_CLOSED;
+        return GPIO_SUCCESS;
+    }
+#endif
+
     if (device->isOpen == GPIO_OPEN)
-    {   // Unexport pin
+    {   // Release the value file and unexport pin
+        close(device->handle);
+        device->isOpen = GPIO_CLOSED;
         fd = open("/sys/class/gpio/unexport", O_WRONLY);
         if (fd < 0) 
         {
@@ -152,12 +282,325 @@ int32_t gpio_close(gpio_info_t* device)
         }
         write_size = snprintf(buffer, 128, "%d", device->pin);
         bytes_written = write(fd, buffer, write_size);
+        close(fd);
         if (bytes_written < write_size) 
         {
             return GPIO_WRITE_ERR;
         }
-        close(fd);
-        device->isOpen = GPIO_CLOSED;
     }
     return GPIO_SUCCESS;
 }
+
+/* sysfs view of one pin of a group */
+static void gpio_group_pin(gpio_group_t* group, uint8_t index, gpio_info_t* device)
+{
+    memset(device, 0, sizeof(gpio_info_t));
+    device->pin = group->pins[index];
+    device->handle = group->handles[index];
+    device->direction = group->direction;
+    device->isOpen = GPIO_OPEN;
+    device->chip = group->chip;
+    device->interface = GPIO_IF_SYSFS;
+}
+
+int32_t gpio_group_init(gpio_group_t* group)
+{
+    gpio_info_t device;
+    int32_t     status;
+    uint8_t     i;
+
+    if ((group->num_pins == 0) || (group->num_pins > GPIO_GROUP_MAX_PINS))
+    {
+        return GPIO_ERROR;
+    }
+
+    if (group->interface == GPIO_IF_CHARDEV)
+    {
+#ifdef GPIO_V2_GET_LINE_IOCTL
+        if (gpio_chardev_request(group->chip, group->pins, group->num_pins, group->direction, 0, 
+                                 GPIO_EDGE_NONE, 0, &group->handle) == GPIO_SUCCESS)
+        {
+            group->isOpen = GPIO_OPEN;
+            return GPIO_SUCCESS;
+        }
+#endif
+        return GPIO_FD_OPEN_ERR;
+    }
+
+    for (i = 0; i < group->num_pins; i++)
+    {
+        gpio_group_pin(group, i, &device);
+        status = gpio_sysfs_init(&device);
+        if (status != GPIO_SUCCESS)
+        {
+            while (i-- > 0)
+            {
+                gpio_group_pin(group, i, &device);
+                gpio_close(&device);
+            }
+            return status;
+        }
+        group->handles[i] = device.handle;
+    }
+
+    group->isOpen = GPIO_OPEN;
+    return GPIO_SUCCESS;
+}
+
+int32_t gpio_group_read(gpio_group_t* group, uint32_t* values)
+{
+    gpio_info_t device;
+    uint8_t     value;
+    uint8_t     i;
+
+    if (group->isOpen != GPIO_OPEN)
+    {
+        return GPIO_READ_ERR;
+    }
+
+#ifdef GPIO_V2_GET_LINE_IOCTL
+    if (group->interface == GPIO_IF_CHARDEV)
+    {
+        struct gpio_v2_line_values line_values;
+
+        line_values.bits = 0;
+        line_values.mask = (group->num_pins == 32) ? 0xFFFFFFFFULL : ((1ULL << group->num_pins) - 1);
+        if (ioctl(group->handle, GPIO_V2_LINE_GET_VALUES_IOCTL, &line_values) < 0)
+        {
+            return GPIO_READ_ERR;
+        }
+        *values = (uint32_t) line_values.bits;
+        return GPIO_SUCCESS;
+    }
+#endif
+
+    *values = 0;
+    for (i = 0; i < group->num_pins; i++)
+    {
+        gpio_group_pin(group, i, &device);
+        if (gpio_read(&device, &value) != GPIO_SUCCESS)
+        {
+            return GPIO_READ_ERR;
+        }
+        *values |= (uint32_t) value << i;
+    }
+
+    return GPIO_SUCCESS;
+}
+
+int32_t gpio_group_write(gpio_group_t* group, uint32_t values, uint32_t mask)
+{
+    gpio_info_t device;
+    uint8_t     i;
+
+    if (group->isOpen != GPIO_OPEN)
+    {
+        return GPIO_WRITE_ERR;
+    }
+
+    if (group->num_pins < 32)
+    {
+        mask &= (1UL << group->num_pins) - 1;
+    }
+
+#ifdef GPIO_V2_GET_LINE_IOCTL
+    if (group->interface == GPIO_IF_CHARDEV)
+    {
+        struct gpio_v2_line_values line_values;
+
+        line_values.bits = values;
+        line_values.mask = mask;
+        if (ioctl(group->handle, GPIO_V2_LINE_SET_VALUES_IOCTL, &line_values) < 0)
+        {
+            return GPIO_WRITE_ERR;
+        }
+        return GPIO_SUCCESS;
+    }
+#endif
+
+    for (i = 0; i < group->num_pins; i++)
+    {
+        if (mask & (1UL << i))
+        {
+            gpio_group_pin(group, i, &device);
+            if (gpio_write(&device, (values >> i) & 1) != GPIO_SUCCESS)
+            {
+                return GPIO_WRITE_ERR;
+            }
+        }
+    }
+
+    return GPIO_SUCCESS;
+}
+
+int32_t gpio_group_close(gpio_group_t* group)
+{
+    gpio_info_t device;
+    int32_t     status = GPIO_SUCCESS;
+    uint8_t     i;
+
+    if (group->isOpen != GPIO_OPEN)
+    {
+        return GPIO_SUCCESS;
+    }
+
+#ifdef GPIO_V2_GET_LINE_IOCTL
+    if (group->interface == GPIO_IF_CHARDEV)
+    {
+        close(group->handle);
+        group->isOpen = GPIO_CLOSED;
+        return GPIO_SUCCESS;
+    }
+#endif
+
+    for (i = 0; i < group->num_pins; i++)
+    {
+        gpio_group_pin(group, i, &device);
+        if (gpio_close(&device) != GPIO_SUCCESS)
+        {
+            status = GPIO_ERROR;
+        }
+    }
+
+    group->isOpen = GPIO_CLOSED;
+    return status;
+}
+
+int32_t gpio_event_fd(gpio_info_t* device)
+{
+#ifdef GPIO_V2_GET_LINE_IOCTL
+    if ((device->isOpen == GPIO_OPEN) && (device->interface == GPIO_IF_CHARDEV) && (device->edge != GPIO_EDGE_NONE))
+    {
+        return device->handle;
+    }
+#endif
+
+    /* sysfs edge notification is not supported */
+    return GPIO_ERROR;
+}
+
+/* events taken from a line request per read */
+#define GPIO_EVENT_BATCH 16
+
+/*
+** Read up to max queued events from a line request, the caller knows one is ready.
+** The kernel returns every queued event that fits, so one read drains up to max.
+** Returns the number of events read or GPIO_READ_ERR.
+*/
+static int32_t gpio_read_events(gpio_info_t* device, gpio_event_t* events, uint32_t max)
+{
+#ifdef GPIO_V2_GET_LINE_IOCTL
+    struct gpio_v2_line_event line_event[GPIO_EVENT_BATCH];
+    ssize_t  bytes;
+    uint32_t count;
+    uint32_t i;
+
+    if (max > GPIO_EVENT_BATCH)
+    {
+        max = GPIO_EVENT_BATCH;
+    }
+
+    bytes = read(device->handle, line_event, max * sizeof(line_event[0]));
+    if ((bytes < (ssize_t) sizeof(line_event[0])) || ((bytes % sizeof(line_event[0])) != 0))
+    {
+        return GPIO_READ_ERR;
+    }
+
+    count = bytes / sizeof(line_event[0]);
+    for (i = 0; i < count; i++)
+    {
+        events[i].timestamp_ns = line_event[i].timestamp_ns;
+        events[i].seqno = line_event[i].line_seqno;
+        events[i].pin = device->pin;
+        events[i].edge = (line_event[i].id == GPIO_V2_LINE_EVENT_RISING_EDGE) ? GPIO_EDGE_RISING : GPIO_EDGE_FALLING;
+    }
+    return (int32_t) count;
+#else
+    return GPIO_READ_ERR;
+#endif
+}
+
+int32_t gpio_wait_event(gpio_info_t* device, gpio_event_t* event, int32_t timeout_ms)
+{
+    struct pollfd pfd;
+    int result;
+
+    pfd.fd = gpio_event_fd(device);
+    if (pfd.fd < 0)
+    {
+        return GPIO_ERROR;
+    }
+    pfd.events = POLLIN;
+
+    result = poll(&pfd, 1, timeout_ms);
+    if (result < 0)
+    {
+        return GPIO_READ_ERR;
+    }
+    if (result == 0)
+    {
+        return GPIO_TIMEOUT_ERR;
+    }
+
+    return (gpio_read_events(device, event, 1) == 1) ? GPIO_SUCCESS : GPIO_READ_ERR;
+}
+
+int32_t gpio_poll_events(gpio_info_t** devices, uint32_t count, int32_t timeout_ms)
+{
+    struct pollfd pfd[GPIO_POLL_MAX_DEVICES];
+    gpio_event_t  events[GPIO_EVENT_BATCH];
+    int32_t       dispatched = 0;
+    int32_t       count_read;
+    int32_t       j;
+    uint32_t      i;
+
+    if ((count == 0) || (count > GPIO_POLL_MAX_DEVICES))
+    {
+        return GPIO_ERROR;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        pfd[i].fd = gpio_event_fd(devices[i]);
+        if (pfd[i].fd < 0)
+        {
+            return GPIO_ERROR;
+        }
+        pfd[i].events = POLLIN;
+        pfd[i].revents = 0;
+    }
+
+    if (poll(pfd, count, timeout_ms) < 0)
+    {
+        return GPIO_READ_ERR;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if ((pfd[i].revents & POLLIN) == 0)
+        {
+            continue;
+        }
+
+        // Drain the fd, a full batch means more events may still be queued
+        do
+        {
+            count_read = gpio_read_events(devices[i], events, GPIO_EVENT_BATCH);
+            if (count_read < 0)
+            {
+                return GPIO_READ_ERR;
+            }
+            for (j = 0; j < count_read; j++)
+            {
+                if (devices[i]->callback != NULL)
+                {
+                    devices[i]->callback(&events[j], devices[i]->callback_arg);
+                }
+                dispatched++;
+            }
+            pfd[i].revents = 0;
+        } while ((count_read == GPIO_EVENT_BATCH) && (poll(&pfd[i], 1, 0) > 0) && (pfd[i].revents & POLLIN));
+    }
+
+    return dispatched;
+}
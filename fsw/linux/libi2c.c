@@ -20,6 +20,152 @@ ivv-itc@lists.nasa.gov
 
 #include "libi2c.h"
 
+/* Select the slave address on the handle, skipping the ioctl when it is already selected */
+static int32_t i2c_set_slave(i2c_bus_info_t* device, uint8_t addr)
+{
+    if (device->cur_addr == addr)
+    {
+        return I2C_SUCCESS;
+    }
+
+    if (ioctl(device->handle, I2C_SLAVE, addr) < 0)
+    {
+        printf("i2c-%d setting slave address = 0x%X FAILED, %s\n", device->handle, addr, strerror(errno));
+        device->cur_addr = I2C_ADDR_NONE;
+        return I2C_ERROR;
+    }
+    device->cur_addr = addr;
+
+    return I2C_SUCCESS;
+}
+
+/* Program the adapter timeout, I2C_TIMEOUT is in units of 10 ms and 0 keeps the current setting */
+static int32_t i2c_set_timeout(i2c_bus_info_t* device, uint16_t timeout)
+{
+    if ((timeout == 0) || (device->timeout == timeout))
+    {
+        return I2C_SUCCESS;
+    }
+
+    if (ioctl(device->handle, I2C_TIMEOUT, (timeout + 9) / 10) < 0)
+    {
+        printf("i2c-%d setting timeout = %u ms FAILED, %s\n", device->handle, timeout, strerror(errno));
+        return I2C_ERROR;
+    }
+    device->timeout = timeout;
+
+    return I2C_SUCCESS;
+}
+
+/* Enable or disable PEC on the handle when the requested state changes */
+static int32_t i2c_set_pec(i2c_bus_info_t* device)
+{
+    uint8_t pec = (device->pec != 0);
+
+    if (device->pec_set == pec)
+    {
+        return I2C_SUCCESS;
+    }
+
+    if (ioctl(device->handle, I2C_PEC, pec) < 0)
+    {
+        printf("i2c-%d setting pec = %u FAILED, %s\n", device->handle, pec, strerror(errno));
+        return I2C_ERROR;
+    }
+    device->pec_set = pec;
+
+    return I2C_SUCCESS;
+}
+
+/*
+** A timed out or busy adapter may mean a slave is holding SDA low, try to free the bus.
+** EAGAIN is lost arbitration on a multi-master bus, which clocking SCL would only disturb.
+*/
+static void i2c_recover_on_error(i2c_bus_info_t* device, int err)
+{
+    if ((err == ETIMEDOUT) || (err == EBUSY))
+    {
+        i2c_bus_recover(device);
+    }
+}
+
+/* 
+** Bus recovery, see the I2C specification section 3.1.16 "Bus clear".
+** SCL is clocked up to nine times until the slave releases SDA, followed by a STOP.
+** The SCL and SDA pins must be usable as GPIOs while the recovery runs.
+*/
+int32_t i2c_bus_recover(i2c_bus_info_t* device)
+{
+    gpio_info_t scl;
+    gpio_info_t sda;
+    uint8_t     value = 0;
+    int32_t     status = I2C_SUCCESS;
+    int         i;
+
+    if (device->recover == 0)
+    {
+        return I2C_SUCCESS;
+    }
+
+    memset(&scl, 0, sizeof(scl));
+    memset(&sda, 0, sizeof(sda));
+    scl.pin = device->scl_pin;
+    scl.direction = GPIO_OUTPUT;
+    scl.interface = GPIO_IF_SYSFS;
+    sda.pin = device->sda_pin;
+    sda.direction = GPIO_INPUT;
+    sda.interface = GPIO_IF_SYSFS;
+
+    if ((gpio_init(&scl) != GPIO_SUCCESS) || (gpio_init(&sda) != GPIO_SUCCESS))
+    {
+        printf("i2c-%d bus recovery FAILED, unable to claim scl %d / sda %d\n", device->handle, device->scl_pin, device->sda_pin);
+        gpio_close(&scl);
+        gpio_close(&sda);
+        return I2C_ERROR;
+    }
+
+    /* Clock until the slave lets go of SDA, 5 us half periods for 100 kHz */
+    for (i = 0; i < 9; i++)
+    {
+        if ((gpio_read(&sda, &value) == GPIO_SUCCESS) && (value == 1))
+        {
+            break;
+        }
+        gpio_write(&scl, 0);
+        usleep(5);
+        gpio_write(&scl, 1);
+        usleep(5);
+    }
+
+    /* Generate a STOP, SDA rising while SCL is high */
+    gpio_close(&sda);
+    sda.direction = GPIO_OUTPUT;
+    if (gpio_init(&sda) == GPIO_SUCCESS)
+    {
+        gpio_write(&scl, 0);
+        gpio_write(&sda, 0);
+        usleep(5);
+        gpio_write(&scl, 1);
+        usleep(5);
+        gpio_write(&sda, 1);
+        usleep(5);
+    }
+
+    if ((gpio_read(&sda, &value) != GPIO_SUCCESS) || (value != 1))
+    {
+        printf("i2c-%d bus recovery FAILED, SDA still held low\n", device->handle);
+        status = I2C_ERROR;
+    }
+
+    gpio_close(&scl);
+    gpio_close(&sda);
+
+    /* The slave address must be selected again after the bus was reset */
+    device->cur_addr = I2C_ADDR_NONE;
+
+    return status;
+}
+
 /* Call to configure a specific i2c device from /dev
 ** i2c_bus- struct with bus configuration
 ** speed  - currently unused
@@ -31,6 +177,12 @@ int32_t i2c_master_init(i2c_bus_info_t* device)
 
     snprintf(devname, 19, "/dev/i2c-%d", device->handle);
     device->handle = open(devname, O_RDWR);
+    device->cur_addr = I2C_ADDR_NONE;
+    device->timeout = 0;
+    device->retries = 0;
+    device->recover = 0;
+    device->pec = 0;
+    device->pec_set = 0;
     if (device->handle < 0)
     {
         printf("i2c bus open failed for handle = %d, %s\n", device->handle, strerror(errno));
@@ -45,15 +197,37 @@ int32_t i2c_master_init(i2c_bus_info_t* device)
     return status;
 }
 
-int32_t i2c_master_transaction(i2c_bus_info_t* device, uint8_t addr, void * txbuf, uint8_t txlen, void * rxbuf, uint8_t rxlen, uint16_t timeout)
+int32_t i2c_master_config(i2c_bus_info_t* device, uint8_t retries, uint8_t recover, uint32_t scl_pin, uint32_t sda_pin)
+{
+    if (device->isOpen != I2C_OPEN)
+    {
+        return I2C_ERROR;
+    }
+
+    /* Bounded retries when the adapter loses arbitration */
+    if ((retries > 0) && (ioctl(device->handle, I2C_RETRIES, retries) < 0))
+    {
+        printf("i2c-%d setting retries = %u FAILED, %s\n", device->handle, retries, strerror(errno));
+        return I2C_ERROR;
+    }
+    device->retries = retries;
+
+    device->recover = recover;
+    device->scl_pin = scl_pin;
+    device->sda_pin = sda_pin;
+
+    return I2C_SUCCESS;
+}
+
+int32_t i2c_master_transaction(i2c_bus_info_t* device, uint8_t addr, void * txbuf, uint16_t txlen, void * rxbuf, uint16_t rxlen, uint16_t timeout)
 {
     int32_t status = I2C_SUCCESS;
     int32_t resp;
+    int     err;
 
-    /* Set I2C slave address */
-    if (ioctl(device->handle, I2C_SLAVE, addr) < 0)
+    /* Set I2C slave address and timeout */
+    if ((i2c_set_slave(device, addr) != I2C_SUCCESS) || (i2c_set_timeout(device, timeout) != I2C_SUCCESS))
     {
-        printf("i2c-%d setting slave address = 0x%X FAILED, %s\n", device->handle, addr, strerror(errno));
         status = I2C_ERROR;
         return status;
     }
@@ -64,8 +238,11 @@ int32_t i2c_master_transaction(i2c_bus_info_t* device, uint8_t addr, void * txbu
         resp = write(device->handle, txbuf, txlen);
         if (resp != txlen)
         {
-            printf("i2c-%d write to address 0x%X FAILED, [%u] %s\n", device->handle, addr, errno, strerror(errno));
+            err = errno;
+            printf("i2c-%d write to address 0x%X FAILED, [%u] %s\n", device->handle, addr, err, strerror(err));
+            i2c_recover_on_error(device, err);
             status = I2C_ERROR;
+            return status;
         }
     }
     /* Perform read if needed */
@@ -74,7 +251,9 @@ int32_t i2c_master_transaction(i2c_bus_info_t* device, uint8_t addr, void * txbu
         resp = read(device->handle, rxbuf, rxlen);
         if (resp != rxlen)
         {
-            printf("i2c-%d read from address 0x%X FAILED, %s\n", device->handle, addr, strerror(errno));
+            err = errno;
+            printf("i2c-%d read from address 0x%X FAILED, %s\n", device->handle, addr, strerror(err));
+            i2c_recover_on_error(device, err);
             status = I2C_ERROR;
         }
     }
@@ -82,15 +261,15 @@ int32_t i2c_master_transaction(i2c_bus_info_t* device, uint8_t addr, void * txbu
     return status;
 }
 
-int32_t i2c_read_transaction(i2c_bus_info_t* device, uint8_t addr, void * rxbuf, uint8_t rxlen, uint8_t timeout)
+int32_t i2c_read_transaction(i2c_bus_info_t* device, uint8_t addr, void * rxbuf, uint16_t rxlen, uint16_t timeout)
 {
     int32_t resp;
     int32_t status = I2C_SUCCESS;
+    int     err;
 
-    /* Set I2C slave address */
-    if (ioctl(device->handle, I2C_SLAVE, addr) < 0)
+    /* Set I2C slave address and timeout */
+    if ((i2c_set_slave(device, addr) != I2C_SUCCESS) || (i2c_set_timeout(device, timeout) != I2C_SUCCESS))
     {
-        printf("i2c-%d setting slave address = 0x%X FAILED, %s\n", device->handle, addr, strerror(errno));
         status = I2C_ERROR;
         return status;
     }
@@ -98,22 +277,24 @@ int32_t i2c_read_transaction(i2c_bus_info_t* device, uint8_t addr, void * rxbuf,
     resp = read(device->handle, rxbuf, rxlen); //<-- ACK would need to go in here
     if (resp != rxlen)
     {
-        printf("i2c-%d read from address 0x%X FAILED, %s\n", device->handle, addr, strerror(errno));
+        err = errno;
+        printf("i2c-%d read from address 0x%X FAILED, %s\n", device->handle, addr, strerror(err));
+        i2c_recover_on_error(device, err);
         status = I2C_ERROR;
     }
 
     return status;
 }
 
-int32_t i2c_write_transaction(i2c_bus_info_t* device, uint8_t addr, void * txbuf, uint8_t txlen, uint8_t timeout)
+int32_t i2c_write_transaction(i2c_bus_info_t* device, uint8_t addr, void * txbuf, uint16_t txlen, uint16_t timeout)
 {
     int32_t resp;
     int32_t status = I2C_SUCCESS;
+    int     err;
 
-    /* Set I2C slave address */
-    if (ioctl(device->handle, I2C_SLAVE, addr) < 0)
+    /* Set I2C slave address and timeout */
+    if ((i2c_set_slave(device, addr) != I2C_SUCCESS) || (i2c_set_timeout(device, timeout) != I2C_SUCCESS))
     {
-        printf("i2c-%d setting slave address = 0x%X FAILED, %s\n", device->handle, addr, strerror(errno));
         status = I2C_ERROR;
         return status;
     }
@@ -121,7 +302,9 @@ int32_t i2c_write_transaction(i2c_bus_info_t* device, uint8_t addr, void * txbuf
     resp = write(device->handle, txbuf, txlen);
     if (resp != txlen)
     {
-        printf("i2c-%d write from address 0x%X FAILED, %s\n", device->handle, addr, strerror(errno));
+        err = errno;
+        printf("i2c-%d write from address 0x%X FAILED, %s\n", device->handle, addr, strerror(err));
+        i2c_recover_on_error(device, err);
         status = I2C_ERROR;
     }
 
@@ -132,22 +315,193 @@ int32_t i2c_multiple_transaction(i2c_bus_info_t* device, uint8_t addr, struct i2
 {
     /* Do combined read/write transaction without stop (simply restarts) in between. */
     int32_t status = I2C_SUCCESS;
+    int     err;
 
-    /* Set I2C slave address */
-    if (ioctl(device->handle, I2C_SLAVE, addr) < 0)
+    if (i2c_set_timeout(device, timeout) != I2C_SUCCESS)
     {
-        printf("i2c-%d setting slave address = 0x%X FAILED, %s\n", device->handle, addr, strerror(errno));
         status = I2C_ERROR;
         return status;
     }
 
-    /* Make the ICOTL call */
+    /* Make the IOCTL call, I2C_RDWR carries the slave address in each message so no I2C_SLAVE is needed */
     if (ioctl(device->handle, I2C_RDWR, rdwr_data) < 0)
     {
-        printf("i2c-%d multple transaction error = 0x%X FAILED, %s\n", device->handle, addr, strerror(errno));
+        err = errno;
+        printf("i2c-%d multple transaction error = 0x%X FAILED, %s\n", device->handle, addr, strerror(err));
+        i2c_recover_on_error(device, err);
+        status = I2C_ERROR;
+        return status;
+    }
+
+    return status;
+}
+
+int32_t i2c_batch_transaction(i2c_bus_info_t* device, i2c_batch_op_t* ops, uint32_t count, uint16_t timeout)
+{
+    int32_t status = I2C_SUCCESS;
+    struct i2c_msg msgs[I2C_MAX_MSGS];
+    struct i2c_rdwr_ioctl_data rdwr_data;
+    uint32_t nmsgs = 0;
+    uint32_t needed;
+    uint32_t i;
+    int      err;
+
+    if (i2c_set_timeout(device, timeout) != I2C_SUCCESS)
+    {
         status = I2C_ERROR;
         return status;
     }
 
+    rdwr_data.msgs = msgs;
+
+    for (i = 0; i < count; i++)
+    {
+        needed = ((ops[i].txlen > 0) ? 1 : 0) + ((ops[i].rxlen > 0) ? 1 : 0);
+
+        /* Flush when the next operation does not fit, operations are never split across ioctls */
+        if ((nmsgs + needed) > I2C_MAX_MSGS)
+        {
+            rdwr_data.nmsgs = nmsgs;
+            if (ioctl(device->handle, I2C_RDWR, &rdwr_data) < 0)
+            {
+                err = errno;
+                printf("i2c-%d batch transaction FAILED, %s\n", device->handle, strerror(err));
+                i2c_recover_on_error(device, err);
+                status = I2C_ERROR;
+                return status;
+            }
+            nmsgs = 0;
+        }
+
+        if (ops[i].txlen > 0)
+        {
+            msgs[nmsgs].addr = ops[i].addr;
+            msgs[nmsgs].flags = 0;
+            msgs[nmsgs].len = ops[i].txlen;
+            msgs[nmsgs].buf = (uint8_t*) ops[i].txbuf;
+            nmsgs++;
+        }
+        if (ops[i].rxlen > 0)
+        {
+            msgs[nmsgs].addr = ops[i].addr;
+            msgs[nmsgs].flags = I2C_M_RD;
+            msgs[nmsgs].len = ops[i].rxlen;
+            msgs[nmsgs].buf = (uint8_t*) ops[i].rxbuf;
+            nmsgs++;
+        }
+    }
+
+    if (nmsgs > 0)
+    {
+        rdwr_data.nmsgs = nmsgs;
+        if (ioctl(device->handle, I2C_RDWR, &rdwr_data) < 0)
+        {
+            err = errno;
+            printf("i2c-%d batch transaction FAILED, %s\n", device->handle, strerror(err));
+            i2c_recover_on_error(device, err);
+            status = I2C_ERROR;
+            return status;
+        }
+    }
+
     return status;
 }
+
+/* One I2C_SMBUS ioctl, the kernel appends and checks the PEC when it is enabled on the handle */
+static int32_t i2c_smbus_access(i2c_bus_info_t* device, uint8_t addr, uint8_t read_write, uint8_t cmd, uint32_t size, union i2c_smbus_data* data, uint16_t timeout)
+{
+    struct i2c_smbus_ioctl_data args;
+    int err;
+
+    if ((i2c_set_slave(device, addr) != I2C_SUCCESS) || (i2c_set_timeout(device, timeout) != I2C_SUCCESS) || 
+        (i2c_set_pec(device) != I2C_SUCCESS))
+    {
+        return I2C_ERROR;
+    }
+
+    args.read_write = read_write;
+    args.command = cmd;
+    args.size = size;
+    args.data = data;
+
+    if (ioctl(device->handle, I2C_SMBUS, &args) < 0)
+    {
+        err = errno;
+        if (err == EBADMSG)
+        {
+            printf("i2c-%d smbus command 0x%X to address 0x%X PEC mismatch\n", device->handle, cmd, addr);
+        }
+        else
+        {
+            printf("i2c-%d smbus command 0x%X to address 0x%X FAILED, %s\n", device->handle, cmd, addr, strerror(err));
+            i2c_recover_on_error(device, err);
+        }
+        return I2C_ERROR;
+    }
+
+    return I2C_SUCCESS;
+}
+
+int32_t smbus_read_byte_data(i2c_bus_info_t* device, uint8_t addr, uint8_t cmd, uint8_t* value, uint16_t timeout)
+{
+    union i2c_smbus_data data;
+
+    if (i2c_smbus_access(device, addr, I2C_SMBUS_READ, cmd, I2C_SMBUS_BYTE_DATA, &data, timeout) != I2C_SUCCESS)
+    {
+        return I2C_ERROR;
+    }
+    *value = data.byte;
+
+    return I2C_SUCCESS;
+}
+
+int32_t smbus_write_byte_data(i2c_bus_info_t* device, uint8_t addr, uint8_t cmd, uint8_t value, uint16_t timeout)
+{
+    union i2c_smbus_data data;
+
+    data.byte = value;
+
+    return i2c_smbus_access(device, addr, I2C_SMBUS_WRITE, cmd, I2C_SMBUS_BYTE_DATA, &data, timeout);
+}
+
+int32_t smbus_read_word_data(i2c_bus_info_t* device, uint8_t addr, uint8_t cmd, uint16_t* value, uint16_t timeout)
+{
+    union i2c_smbus_data data;
+
+    if (i2c_smbus_access(device, addr, I2C_SMBUS_READ, cmd, I2C_SMBUS_WORD_DATA, &data, timeout) != I2C_SUCCESS)
+    {
+        return I2C_ERROR;
+    }
+    *value = data.word;
+
+    return I2C_SUCCESS;
+}
+
+int32_t smbus_write_word_data(i2c_bus_info_t* device, uint8_t addr, uint8_t cmd, uint16_t value, uint16_t timeout)
+{
+    union i2c_smbus_data data;
+
+    data.word = value;
+
+    return i2c_smbus_access(device, addr, I2C_SMBUS_WRITE, cmd, I2C_SMBUS_WORD_DATA, &data, timeout);
+}
+
+int32_t smbus_block_read(i2c_bus_info_t* device, uint8_t addr, uint8_t cmd, uint8_t* data, uint8_t* len, uint16_t timeout)
+{
+    union i2c_smbus_data block;
+
+    if (i2c_smbus_access(device, addr, I2C_SMBUS_READ, cmd, I2C_SMBUS_BLOCK_DATA, &block, timeout) != I2C_SUCCESS)
+    {
+        return I2C_ERROR;
+    }
+
+    /* block[0] holds the count returned by the slave */
+    if (block.block[0] > SMBUS_BLOCK_MAX)
+    {
+        return I2C_ERROR;
+    }
+    memcpy(data, &block.block[1], block.block[0]);
+    *len = block.block[0];
+
+    return I2C_SUCCESS;
+}
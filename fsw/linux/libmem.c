@@ -4,8 +4,17 @@
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
+#include <stdlib.h>
+#include <poll.h>
+#include <pthread.h>
 #include "libmem.h"
 
+/* pages used by Xil_MMAP_In32/Xil_MMAP_Out32, mapped on first use and kept for the life of the process */
+#define XIL_MMAP_PAGES 16
+
+static mem_region_t    xil_mmap_page[XIL_MMAP_PAGES]; 
+static pthread_mutex_t xil_mmap_mutex = PTHREAD_MUTEX_INITIALIZER; 
+
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  *
  * Xil_MMAP() - Map physical address to userspace using mmap intermediary with /dev/mem. 
@@ -46,9 +55,8 @@ void *Xil_MMAP(__off_t address, size_t length){
  *                      Mapped intermediary buffers must be freed since they are dynamically allocated with MMAP. 
  *                      The kernel periodically syncs mapped buffer changes. This should be done explicitly prior
  *                      to close however just to make sure. The msync() function does this. 
- *                      TODO: Normally the flag MS_SYNC given to msync tells it to wait for completion of the sync
- *                      before moving forward. This is currently broken and results in msync returning EINVAL. As
- *                      an alternative, we're just waiting explicitly for it to finish. 
+ *                      /dev/mem is opened with O_SYNC, so the mapping is uncached and the stores have reached
+ *                      the device by the time msync returns; no extra wait is needed. 
  *  
  * Inputs:              __off_t shared_addr:    Mapped buffer address previously returned by MMAP
  *                      __off_t address:        Physical address previously mapped by MMAP 
@@ -67,7 +75,6 @@ void Xil_MMAP_close(__off_t shared_addr, __off_t address, size_t length, int rea
             error = errno; 
             OS_printf("MSYNC ERROR = %d\n", error); 
         }
-        usleep(10000); 
     }
 
     if(munmap((void *)(shared_addr - page_offset), page_offset + length)){
@@ -78,7 +85,38 @@ void Xil_MMAP_close(__off_t shared_addr, __off_t address, size_t length, int rea
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  *  
- * Xil_MMAP_Out32() -   Write 32-bit register from userspace. 
+ * Xil_MMAP_region() -  Find or map the cached page holding a 32-bit register. Pages are never unmapped, so the
+ *                      region stays valid after the lock is released.
+ *
+ * Inputs:              unsigned int Addr:      Register address
+ * Outputs:             returns mem_region_t *: Cached page, NULL when the cache is full or the map fails
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static mem_region_t *Xil_MMAP_region(unsigned int Addr){
+    uint32_t      pagesize  = sysconf(_SC_PAGE_SIZE); 
+    uint32_t      page_base = (Addr / pagesize) * pagesize; 
+    mem_region_t *region    = NULL; 
+    int           i; 
+
+    pthread_mutex_lock(&xil_mmap_mutex); 
+    for(i = 0; (i < XIL_MMAP_PAGES) && (xil_mmap_page[i].isOpen == MEM_OPEN); i++){
+        if(xil_mmap_page[i].base == page_base){
+            region = &xil_mmap_page[i]; 
+            break; 
+        }
+    }
+    if((region == NULL) && (i < XIL_MMAP_PAGES) && (mem_region_open(page_base, pagesize, &xil_mmap_page[i]) == MEM_SUCCESS)){
+        region = &xil_mmap_page[i]; 
+    }
+    pthread_mutex_unlock(&xil_mmap_mutex); 
+
+    return region; 
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  
+ * Xil_MMAP_Out32() -   Write 32-bit register from userspace. The page is mapped once and cached, registers beyond
+ *                      the first XIL_MMAP_PAGES pages are mapped for each access.
  *
  * Inputs:              unsigned int Addr:      Register address to write to
  *                      unsigned int Value:     32-bit value to write 
@@ -86,6 +124,12 @@ void Xil_MMAP_close(__off_t shared_addr, __off_t address, size_t length, int rea
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 void Xil_MMAP_Out32(unsigned int Addr, unsigned int Value){
 	volatile unsigned int   *LocalAddr;
+    mem_region_t            *region; 
+
+    if((region = Xil_MMAP_region(Addr)) != NULL){
+        mem_region_write32(region, Addr - region->base, Value); 
+        return; 
+    }
 
 	if((LocalAddr = Xil_MMAP(Addr, 4)) == NULL)
 		return; 
@@ -97,7 +141,8 @@ void Xil_MMAP_Out32(unsigned int Addr, unsigned int Value){
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  *  
- * Xil_MMAP_In32() -    Read 32-bit register from userspace.
+ * Xil_MMAP_In32() -    Read 32-bit register from userspace. The page is mapped once and cached, registers beyond
+ *                      the first XIL_MMAP_PAGES pages are mapped for each access.
  *
  * Inputs:              unsigned int Addr:      Register address to read from
  * Outputs:             returns unsigned int:   Data from register 
@@ -106,6 +151,11 @@ void Xil_MMAP_Out32(unsigned int Addr, unsigned int Value){
 unsigned int Xil_MMAP_In32(unsigned int Addr){
 	volatile unsigned int  *LocalAddr;
     unsigned int           res; 
+    mem_region_t          *region; 
+
+    if((region = Xil_MMAP_region(Addr)) != NULL){
+        return mem_region_read32(region, Addr - region->base); 
+    }
 
 	if((LocalAddr = Xil_MMAP(Addr, 4)) == NULL)
 		return -1; 
@@ -118,7 +168,81 @@ unsigned int Xil_MMAP_In32(unsigned int Addr){
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  *  
- * devmem_write() - Higher-level function to write physical memory from user-space. 
+ * mem_region_open() -  Map a physical address window with /dev/mem and keep it mapped. Registers are then accessed
+ *                      through region->addr with plain volatile loads and stores. /dev/mem is opened with O_SYNC
+ *                      so the mapping is uncached and no msync is needed.
+ *
+ * Inputs:              uint32_t base:          Physical base address
+ *                      uint32_t length:        Length of the window
+ *                      mem_region_t *region:   Region information, filled in on success
+ *
+ * Outputs:             returns int32_t:        MEM_SUCCESS or MEM_ERROR
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+int32_t mem_region_open(uint32_t base, uint32_t length, mem_region_t *region){
+    size_t  pagesize    = sysconf(_SC_PAGE_SIZE); 
+    __off_t page_base   = (base / pagesize) * pagesize; 
+    __off_t page_offset = base - page_base; 
+    void   *map; 
+    int     fd, error; 
+
+    if(length == 0)
+        return MEM_ERROR; 
+
+    if((fd = open("/dev/mem", O_RDWR | O_SYNC)) < 0){
+        error = errno; 
+        OS_printf("LIBMEM OPEN ERROR = %d\n", error); 
+        return MEM_ERROR; 
+    }
+
+    map = mmap(NULL, page_offset + length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, page_base); 
+    close(fd); 
+    if(map == MAP_FAILED){
+        error = errno; 
+        OS_printf("MMAP ERROR = %d\n", error); 
+        return MEM_ERROR; 
+    }
+
+    region->base       = base; 
+    region->length     = length; 
+    region->map        = map; 
+    region->map_length = page_offset + length; 
+    region->addr       = (volatile uint8_t *)map + page_offset; 
+    region->handle     = -1; 
+    region->isOpen     = MEM_OPEN; 
+
+    return MEM_SUCCESS; 
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  
+ * mem_region_close() - Unmap a window previously mapped by mem_region_open().
+ *
+ * Inputs:              mem_region_t *region:   Region information
+ *
+ * Outputs:             returns int32_t:        MEM_SUCCESS or MEM_ERROR
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+int32_t mem_region_close(mem_region_t *region){
+    int error; 
+
+    if(region->isOpen != MEM_OPEN)
+        return MEM_SUCCESS; 
+
+    region->isOpen = MEM_CLOSED; 
+    if(munmap(region->map, region->map_length)){
+        error = errno; 
+        OS_printf("MUNMAP ERROR = %d\n", error); 
+        return MEM_ERROR; 
+    }
+
+    return MEM_SUCCESS; 
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  
+ * devmem_write() - Higher-level function to write physical memory from user-space. Maps the window for this call
+ *                  only, use mem_region_open() for repeated accesses. Uses the widest aligned accesses.
  *
  * Inputs:          unsigned int addr:  Address to write to
  *                  unsigned char *in:  Input data to write
@@ -128,24 +252,24 @@ unsigned int Xil_MMAP_In32(unsigned int Addr){
  *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 int32_t devmem_write(uint32_t addr, uint8_t *in, int32_t length){
-	volatile unsigned char *LocalAddr;
-    int                     byte;  
+    mem_region_t region; 
+    int32_t      status;  
 
-	if((LocalAddr = Xil_MMAP(addr, length)) == NULL)
-		return -1;  
+    if((length <= 0) || (mem_region_open(addr, length, &region) != MEM_SUCCESS))
+        return -1;  
 
-    for(byte = 0; byte < length; byte++)
-        LocalAddr[byte] = in[byte]; 
+    status = mem_region_copy_to(&region, 0, in, length); 
 
-    Xil_MMAP_close((unsigned long int)LocalAddr, addr, length, 0); 
+    mem_region_close(&region); 
 
-    return length; 
+    return (status == MEM_SUCCESS) ? length : -1; 
 }
 
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  *  
- * devmem_read() -  Higher-level function to read physical memory from user-space. 
+ * devmem_read() -  Higher-level function to read physical memory from user-space. Maps the window for this call
+ *                  only, use mem_region_open() for repeated accesses. Uses the widest aligned accesses.
  *
  * Inputs:          unsigned int addr:  Address to read from
  *                  unsigned char *out: Output buffer to read into
@@ -155,16 +279,237 @@ int32_t devmem_write(uint32_t addr, uint8_t *in, int32_t length){
  *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 int32_t devmem_read(uint32_t addr, uint8_t *out, int32_t length){
-	volatile unsigned char *LocalAddr;
-    int                     byte;
+    mem_region_t region; 
+    int32_t      status;
+
+    if((length <= 0) || (mem_region_open(addr, length, &region) != MEM_SUCCESS))
+        return -1;  
+
+    status = mem_region_copy_from(&region, 0, out, length); 
+
+    mem_region_close(&region); 
+
+    return (status == MEM_SUCCESS) ? length : -1; 
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  
+ * mem_dma_attr() - Read or write a u-dma-buf sysfs attribute. Newer drivers use the u-dma-buf class, older ones
+ *                  the udmabuf class.
+ *
+ * Inputs:          const char *name:   Device name
+ *                  const char *attr:   Attribute name
+ *                  char *value:        Value to write, or buffer for the value read
+ *                  size_t length:      Size of the buffer when reading, 0 to write
+ *
+ * Outputs:         returns int32_t:    MEM_SUCCESS or MEM_ERROR
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static int32_t mem_dma_attr(const char *name, const char *attr, char *value, size_t length){
+    static const char *classes[] = {"/sys/class/u-dma-buf", "/sys/class/udmabuf"}; 
+    char    path[128]; 
+    ssize_t result; 
+    size_t  i; 
+    int     fd = -1; 
+
+    for(i = 0; (i < sizeof(classes) / sizeof(classes[0])) && (fd < 0); i++){
+        snprintf(path, sizeof(path), "%s/%s/%s", classes[i], name, attr); 
+        fd = open(path, (length == 0) ? O_WRONLY : O_RDONLY); 
+    }
+    if(fd < 0)
+        return MEM_ERROR; 
+
+    if(length == 0){
+        result = write(fd, value, strlen(value)); 
+        result = (result == (ssize_t)strlen(value)) ? 0 : -1; 
+    }
+    else{
+        result = read(fd, value, length - 1); 
+        if(result >= 0)
+            value[result] = '\0'; 
+    }
+    close(fd); 
+
+    return (result < 0) ? MEM_ERROR : MEM_SUCCESS; 
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  
+ * mem_dma_open() - Map a u-dma-buf buffer. The buffer is opened without O_SYNC so the CPU mapping is cacheable,
+ *                  callers hand ownership back and forth with mem_dma_sync_for_cpu/mem_dma_sync_for_device.
+ *
+ * Inputs:          const char *name:       Device name, e.g. "udmabuf0"
+ *                  mem_dma_buf_t *buf:     Buffer information, filled in on success
+ *
+ * Outputs:         returns int32_t:        MEM_SUCCESS or MEM_ERROR
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+int32_t mem_dma_open(const char *name, mem_dma_buf_t *buf){
+    char  value[32]; 
+    char  path[64]; 
+    void *map; 
+    int   fd, error; 
+
+    if((mem_dma_attr(name, "phys_addr", value, sizeof(value)) != MEM_SUCCESS))
+        return MEM_ERROR; 
+    buf->phys_addr = strtoull(value, NULL, 0); 
+
+    if((mem_dma_attr(name, "size", value, sizeof(value)) != MEM_SUCCESS))
+        return MEM_ERROR; 
+    buf->size = strtoull(value, NULL, 0); 
+
+    snprintf(path, sizeof(path), "/dev/%s", name); 
+    if((fd = open(path, O_RDWR)) < 0){
+        error = errno; 
+        OS_printf("LIBMEM DMA OPEN %s ERROR = %d\n", path, error); 
+        return MEM_ERROR; 
+    }
+
+    map = mmap(NULL, buf->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0); 
+    if(map == MAP_FAILED){
+        error = errno; 
+        OS_printf("MMAP ERROR = %d\n", error); 
+        close(fd); 
+        return MEM_ERROR; 
+    }
+
+    strncpy(buf->name, name, sizeof(buf->name) - 1); 
+    buf->name[sizeof(buf->name) - 1] = '\0'; 
+    buf->addr   = map; 
+    buf->handle = fd; 
+    buf->isOpen = MEM_OPEN; 
+
+    return MEM_SUCCESS; 
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  
+ * mem_dma_close() -    Unmap a buffer previously mapped by mem_dma_open().
+ *
+ * Inputs:              mem_dma_buf_t *buf:     Buffer information
+ *
+ * Outputs:             returns int32_t:        MEM_SUCCESS or MEM_ERROR
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+int32_t mem_dma_close(mem_dma_buf_t *buf){
+    int32_t status = MEM_SUCCESS; 
+
+    if(buf->isOpen != MEM_OPEN)
+        return MEM_SUCCESS; 
+
+    buf->isOpen = MEM_CLOSED; 
+    if(munmap(buf->addr, buf->size))
+        status = MEM_ERROR; 
+    close(buf->handle); 
+
+    return status; 
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  
+ * mem_dma_sync() - Sync part of a buffer through the driver's sync_offset/sync_size/sync_direction attributes
+ *                  followed by a write to sync_for_cpu or sync_for_device.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static int32_t mem_dma_sync(mem_dma_buf_t *buf, size_t offset, size_t length, const char *attr){
+    char value[32]; 
+
+    if((buf->isOpen != MEM_OPEN) || (offset > buf->size) || (length > buf->size - offset))
+        return MEM_ERROR; 
+
+    snprintf(value, sizeof(value), "%zu", offset); 
+    if(mem_dma_attr(buf->name, "sync_offset", value, 0) != MEM_SUCCESS)
+        return MEM_ERROR; 
+
+    snprintf(value, sizeof(value), "%zu", length); 
+    if(mem_dma_attr(buf->name, "sync_size", value, 0) != MEM_SUCCESS)
+        return MEM_ERROR; 
+
+    /* 0 is DMA_BIDIRECTIONAL */
+    strcpy(value, "0"); 
+    if(mem_dma_attr(buf->name, "sync_direction", value, 0) != MEM_SUCCESS)
+        return MEM_ERROR; 
+
+    strcpy(value, "1"); 
+    return mem_dma_attr(buf->name, attr, value, 0); 
+}
+
+int32_t mem_dma_sync_for_cpu(mem_dma_buf_t *buf, size_t offset, size_t length){
+    return mem_dma_sync(buf, offset, length, "sync_for_cpu"); 
+}
+
+int32_t mem_dma_sync_for_device(mem_dma_buf_t *buf, size_t offset, size_t length){
+    return mem_dma_sync(buf, offset, length, "sync_for_device"); 
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  
+ * mem_uio_open() - Open /dev/uioN. Reading the fd blocks until the next interrupt and returns the interrupt count,
+ *                  writing 1 unmasks the interrupt.
+ *
+ * Inputs:          uint32_t uio:           N of /dev/uioN
+ *                  mem_uio_t *device:      UIO information, filled in on success
+ *
+ * Outputs:         returns int32_t:        MEM_SUCCESS or MEM_ERROR
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+int32_t mem_uio_open(uint32_t uio, mem_uio_t *device){
+    char path[32]; 
+    int  fd, error; 
 
-	if((LocalAddr = Xil_MMAP(addr, length)) == NULL)
-		return -1;  
+    snprintf(path, sizeof(path), "/dev/uio%u", uio); 
+    if((fd = open(path, O_RDWR)) < 0){
+        error = errno; 
+        OS_printf("LIBMEM UIO OPEN %s ERROR = %d\n", path, error); 
+        return MEM_ERROR; 
+    }
 
-    for(byte = 0; byte < length; byte++)
-        out[byte] = LocalAddr[byte]; 
+    device->uio    = uio; 
+    device->handle = fd; 
+    device->count  = 0; 
+    device->shm    = NULL; 
+    device->isOpen = MEM_OPEN; 
 
-    Xil_MMAP_close((unsigned long int)LocalAddr, addr, length, 1); 
+    return MEM_SUCCESS; 
+}
+
+int32_t mem_uio_irq_enable(mem_uio_t *device){
+    uint32_t enable = 1; 
+
+    if((device->isOpen != MEM_OPEN) || (write(device->handle, &enable, sizeof(enable)) != sizeof(enable)))
+        return MEM_ERROR; 
+
+    return MEM_SUCCESS; 
+}
+
+int32_t mem_uio_wait(mem_uio_t *device, int32_t timeout_ms){
+    struct pollfd pfd; 
+    uint32_t      count; 
+    int           result; 
+
+    if(device->isOpen != MEM_OPEN)
+        return MEM_ERROR; 
+
+    pfd.fd     = device->handle; 
+    pfd.events = POLLIN; 
+    result = poll(&pfd, 1, timeout_ms); 
+    if(result < 0)
+        return MEM_ERROR; 
+    if(result == 0)
+        return MEM_TIMEOUT_ERR; 
+
+    if(read(device->handle, &count, sizeof(count)) != sizeof(count))
+        return MEM_ERROR; 
+    device->count = count; 
+
+    return MEM_SUCCESS; 
+}
+
+int32_t mem_uio_close(mem_uio_t *device){
+    if(device->isOpen == MEM_OPEN){
+        close(device->handle); 
+        device->isOpen = MEM_CLOSED; 
+    }
 
-    return length; 
+    return MEM_SUCCESS; 
 }
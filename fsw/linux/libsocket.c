@@ -1,8 +1,10 @@
+#define _GNU_SOURCE
 #include "libsocket.h"
 
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <fcntl.h>
+#include <netdb.h>
 #include <errno.h>
 
 // Creates an endpoint for communication
@@ -448,3 +450,182 @@ int32_t socket_close(socket_info_t* socket_info)
 
     return status;
 }
+
+// Resolves a host name or dotted address and port once, for socket_send_to and socket_send_batch
+int32_t socket_addr_resolve(socket_addr_t* addr, const char* host, int port_num)
+{
+    struct addrinfo hints;
+    struct addrinfo* res;
+
+    memset(addr, 0, sizeof(socket_addr_t));
+    addr->addr.sin_family = AF_INET;
+    addr->addr.sin_port = htons(port_num);
+
+    if(inet_pton(AF_INET, host, &addr->addr.sin_addr) == 1)
+    {
+        return SOCKET_SUCCESS;
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET; // IPV4 only, like socket_create
+    hints.ai_socktype = SOCK_DGRAM;
+    if( (getaddrinfo(host, NULL, &hints, &res) != 0) || (res == NULL) )
+    {
+        OS_printf("socket_addr_resolve: Unable to resolve %s\n", host);
+        return SOCKET_ERROR;
+    }
+
+    addr->addr.sin_addr = ((struct sockaddr_in*) res->ai_addr)->sin_addr;
+    freeaddrinfo(res);
+
+    return SOCKET_SUCCESS;
+}
+
+// Sends one datagram to a pre-resolved address
+int32_t socket_send_to(socket_info_t* socket_info, uint8_t* buffer, size_t buflen, size_t* bytes_sent, const socket_addr_t* addr)
+{
+    ssize_t ret;
+
+    if( (socket_info->type != dgram) || (addr == NULL) )
+    {
+        return SOCKET_SEND_ERR;
+    }
+
+    ret = sendto(socket_info->sockfd, (void*)buffer, buflen, 0, (const struct sockaddr *)&addr->addr, sizeof(addr->addr));
+    if(ret == -1)
+    {
+        if( (socket_info->block==false) && ((errno==EAGAIN) || (errno==EWOULDBLOCK)) )
+        {
+            return SOCKET_TRY_AGAIN;
+        }
+        return SOCKET_SEND_ERR;
+    }
+
+    *bytes_sent = ret;
+
+    return SOCKET_SUCCESS;
+}
+
+// Sends count datagrams with as few sendmmsg calls as possible
+// On an error num_sent tells how many went out; SOCKET_TRY_AGAIN means a non-blocking socket is full
+int32_t socket_send_batch(socket_info_t* socket_info, socket_datagram_t* datagrams, uint32_t count, uint32_t* num_sent)
+{
+    struct mmsghdr msgs[SOCKET_BATCH_MAX];
+    struct iovec iov[SOCKET_BATCH_MAX];
+    uint32_t chunk;
+    uint32_t i;
+    int ret;
+
+    *num_sent = 0;
+
+    if(socket_info->type != dgram)
+    {
+        return SOCKET_SEND_ERR;
+    }
+
+    // Without a destination the socket must be connected to its peer
+    for(i = 0; i < count; i++)
+    {
+        if( (datagrams[i].addr == NULL) && (!socket_info->connected) )
+        {
+            return SOCKET_SEND_ERR;
+        }
+    }
+
+    while(*num_sent < count)
+    {
+        chunk = count - *num_sent;
+        if(chunk > SOCKET_BATCH_MAX)
+        {
+            chunk = SOCKET_BATCH_MAX;
+        }
+
+        memset(msgs, 0, chunk * sizeof(struct mmsghdr));
+        for(i = 0; i < chunk; i++)
+        {
+            iov[i].iov_base = datagrams[*num_sent + i].buffer;
+            iov[i].iov_len = datagrams[*num_sent + i].buflen;
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            if(datagrams[*num_sent + i].addr != NULL)
+            {
+                msgs[i].msg_hdr.msg_name = &datagrams[*num_sent + i].addr->addr;
+                msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+            }
+        }
+
+        ret = sendmmsg(socket_info->sockfd, msgs, chunk, 0);
+        if(ret == -1)
+        {
+            if( (socket_info->block==false) && ((errno==EAGAIN) || (errno==EWOULDBLOCK)) )
+            {
+                return SOCKET_TRY_AGAIN;
+            }
+            return SOCKET_SEND_ERR;
+        }
+
+        for(i = 0; i < (uint32_t) ret; i++)
+        {
+            datagrams[*num_sent + i].length = msgs[i].msg_len;
+        }
+        *num_sent += ret;
+    }
+
+    return SOCKET_SUCCESS;
+}
+
+// Receives up to count datagrams with one recvmmsg call
+// A blocking socket waits for the first datagram only, then takes whatever else is queued
+// A datagram longer than its buffer is cut to buflen and flagged truncated
+int32_t socket_recv_batch(socket_info_t* socket_info, socket_datagram_t* datagrams, uint32_t count, uint32_t* num_recvd)
+{
+    struct mmsghdr msgs[SOCKET_BATCH_MAX];
+    struct iovec iov[SOCKET_BATCH_MAX];
+    uint32_t i;
+    int ret;
+
+    *num_recvd = 0;
+
+    if(socket_info->type != dgram)
+    {
+        return SOCKET_RECV_ERR;
+    }
+
+    if(count > SOCKET_BATCH_MAX)
+    {
+        count = SOCKET_BATCH_MAX;
+    }
+
+    memset(msgs, 0, count * sizeof(struct mmsghdr));
+    for(i = 0; i < count; i++)
+    {
+        iov[i].iov_base = datagrams[i].buffer;
+        iov[i].iov_len = datagrams[i].buflen;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        if(datagrams[i].addr != NULL)
+        {
+            msgs[i].msg_hdr.msg_name = &datagrams[i].addr->addr;
+            msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        }
+    }
+
+    ret = recvmmsg(socket_info->sockfd, msgs, count, MSG_WAITFORONE, NULL);
+    if(ret == -1)
+    {
+        if( (socket_info->block==false) && ((errno==EAGAIN) || (errno==EWOULDBLOCK)) )
+        {
+            return SOCKET_TRY_AGAIN;
+        }
+        return SOCKET_RECV_ERR;
+    }
+
+    for(i = 0; i < (uint32_t) ret; i++)
+    {
+        datagrams[i].length = msgs[i].msg_len;
+        datagrams[i].truncated = ((msgs[i].msg_hdr.msg_flags & MSG_TRUNC) != 0);
+    }
+    *num_recvd = ret;
+
+    return SOCKET_SUCCESS;
+}
@@ -15,10 +15,81 @@ NASA IV&V
 ivv-itc@lists.nasa.gov
 */
 
+#include <time.h>
 #include "libspi.h"
 
+/*
+** Bus mutexes are OSAL mutexes, which the POSIX OSAL creates with 
+** PTHREAD_PRIO_INHERIT so a low priority holder is boosted while it 
+** blocks a higher priority task waiting on the same bus.
+*/
 spi_mutex_t spi_bus_mutex[MAX_SPI_BUSES];
 
+static uint64_t spi_time_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+}
+
+/* Record the new bus holder, called with the bus mutex held */
+static void spi_hold_begin(uint8_t bus, uint8_t cs)
+{
+  OS_MutSemTake(spi_bus_mutex[bus].stats_mutex);
+  spi_bus_mutex[bus].stats.holder = cs;
+  spi_bus_mutex[bus].stats.hold_start_ns = spi_time_ns();
+  OS_MutSemGive(spi_bus_mutex[bus].stats_mutex);
+}
+
+/* Account the finished hold, called before the bus mutex is released */
+static void spi_hold_end(uint8_t bus, uint8_t cs)
+{
+  spi_bus_stats_t* stats = &spi_bus_mutex[bus].stats;
+  spi_hold_stats_t* cs_stats;
+  uint64_t held_ns;
+  uint32_t max_hold_us;
+  int report = 0;
+
+  OS_MutSemTake(spi_bus_mutex[bus].stats_mutex);
+  if (stats->holder != cs)
+  {
+    OS_MutSemGive(spi_bus_mutex[bus].stats_mutex);
+    return;
+  }
+
+  held_ns = spi_time_ns() - stats->hold_start_ns;
+  stats->holder = SPI_BUS_FREE;
+
+  if (cs >= MAX_SPI_CHIP_SELECTS)
+  {
+    OS_MutSemGive(spi_bus_mutex[bus].stats_mutex);
+    return;
+  }
+
+  cs_stats = &stats->cs[cs];
+  cs_stats->hold_count++;
+  cs_stats->total_hold_ns += held_ns;
+  if (held_ns > cs_stats->max_hold_ns)
+  {
+    cs_stats->max_hold_ns = held_ns;
+  }
+
+  max_hold_us = stats->max_hold_us;
+  if ((max_hold_us != 0) && (held_ns > ((uint64_t) max_hold_us * 1000)))
+  {
+    // don't spam
+    report = (cs_stats->overrun_count++ < 10);
+  }
+  OS_MutSemGive(spi_bus_mutex[bus].stats_mutex);
+
+  if (report)
+  {
+    OS_printf("HWLIB: spi bus %d cs %d held for %llu us, limit is %u us\n", bus, cs, 
+              (unsigned long long) (held_ns / 1000), max_hold_us);
+  }
+}
+
 int32_t spi_init_dev(spi_info_t* device)
 {
   int32_t status = SPI_SUCCESS;
@@ -36,11 +107,21 @@ int32_t spi_init_dev(spi_info_t* device)
         OS_printf("HWLIB: Create spi mutex error %d", status);
         return status;
       }
+      snprintf(buffer, 16, "spi_%d_stats", device->bus);
+      status = OS_MutSemCreate(&spi_bus_mutex[device->bus].stats_mutex, buffer, 0);
+      if (status != OS_SUCCESS)
+      {
+        OS_MutSemDelete(spi_bus_mutex[device->bus].spi_mutex);
+        OS_printf("HWLIB: Create spi stats mutex error %d", status);
+        return status;
+      }
+      spi_bus_mutex[device->bus].stats.holder = SPI_BUS_FREE;
     }
     spi_bus_mutex[device->bus].users++;
   }
   else
   {
+    status = SPI_ERR_INVAL_BUS;
     OS_printf("HWLIB: Create spi mutex error %d, bus invalid!", status);
     return status;
   }
@@ -226,6 +307,45 @@ int32_t spi_transaction(spi_info_t* device, uint8_t *txBuff, uint8_t * rxBuffer,
   return status;
 }
 
+int32_t spi_multiple_transaction(spi_info_t* device, spi_transfer_t* xfers, uint32_t count)
+{
+  int32_t status = SPI_SUCCESS;
+  int ret;
+  uint32_t i;
+  struct spi_ioc_transfer xfer[MAX_SPI_TRANSFERS];
+
+  if ((count == 0) || (count > MAX_SPI_TRANSFERS))
+  {
+    status = SPI_ERROR;
+    return status;
+  }
+
+  // Clear the xfer structs
+  memset((void *)xfer, 0, sizeof(struct spi_ioc_transfer) * count);
+
+  // Setup one transfer structure per transfer, the driver runs them back to back
+  for (i = 0; i < count; i++)
+  {
+    xfer[i].tx_buf = (unsigned long) xfers[i].txBuff;
+    xfer[i].rx_buf = (unsigned long) xfers[i].rxBuff;
+    xfer[i].len = xfers[i].length;
+    xfer[i].speed_hz = device->baudrate;
+    xfer[i].delay_usecs = xfers[i].delay;
+    xfer[i].bits_per_word = xfers[i].bits;
+    xfer[i].cs_change = xfers[i].deselect;
+  }
+
+  // Perform all transfers in one message
+  ret = ioctl(device->handle, SPI_IOC_MESSAGE(count), xfer);
+  if (ret < 1)
+  {
+      status = SPI_ERR_IOC_MSG;
+      return status;
+  }
+
+  return status;
+}
+
 int32_t spi_select_chip(spi_info_t* device)
 {
   int32_t status = SPI_SUCCESS;
@@ -237,7 +357,17 @@ int32_t spi_select_chip(spi_info_t* device)
   *  Each SPI device is deselected when it's not in active use, allowing
   *  other drivers to talk to other devices."
   */
+  if (device->bus >= MAX_SPI_BUSES)
+  {
+    status = SPI_ERR_INVAL_BUS;
+    return status;
+  }
+
   status = OS_MutSemTake(spi_bus_mutex[device->bus].spi_mutex);
+  if (status == OS_SUCCESS)
+  {
+    spi_hold_begin(device->bus, device->cs);
+  }
   
   return status;
 }
@@ -253,11 +383,62 @@ int32_t spi_unselect_chip(spi_info_t* device)
   *  Each SPI device is deselected when it's not in active use, allowing
   *  other drivers to talk to other devices."
   */
+  if (device->bus >= MAX_SPI_BUSES)
+  {
+    status = SPI_ERR_INVAL_BUS;
+    return status;
+  }
+
+  spi_hold_end(device->bus, device->cs);
   status = OS_MutSemGive(spi_bus_mutex[device->bus].spi_mutex);
   
   return status;
 }
 
+int32_t spi_set_max_hold_time(uint8_t bus, uint32_t max_hold_us)
+{
+  if (bus >= MAX_SPI_BUSES)
+  {
+    return SPI_ERR_INVAL_BUS;
+  }
+
+  // The stats mutex only exists while a device on the bus is open
+  if (spi_bus_mutex[bus].users == 0)
+  {
+    spi_bus_mutex[bus].stats.max_hold_us = max_hold_us;
+  }
+  else if (OS_MutSemTake(spi_bus_mutex[bus].stats_mutex) == OS_SUCCESS)
+  {
+    spi_bus_mutex[bus].stats.max_hold_us = max_hold_us;
+    OS_MutSemGive(spi_bus_mutex[bus].stats_mutex);
+  }
+  else
+  {
+    return SPI_ERROR;
+  }
+
+  return SPI_SUCCESS;
+}
+
+int32_t spi_get_bus_stats(uint8_t bus, spi_bus_stats_t* stats)
+{
+  if (bus >= MAX_SPI_BUSES)
+  {
+    return SPI_ERR_INVAL_BUS;
+  }
+
+  // The stats mutex only exists while a device on the bus is open
+  if ((spi_bus_mutex[bus].users == 0) || (OS_MutSemTake(spi_bus_mutex[bus].stats_mutex) != OS_SUCCESS))
+  {
+    return SPI_ERROR;
+  }
+
+  memcpy(stats, &spi_bus_mutex[bus].stats, sizeof(spi_bus_stats_t));
+  OS_MutSemGive(spi_bus_mutex[bus].stats_mutex);
+
+  return SPI_SUCCESS;
+}
+
 int32_t spi_close_device(spi_info_t* device)
 {
   int32_t status = SPI_SUCCESS;
@@ -269,6 +450,7 @@ int32_t spi_close_device(spi_info_t* device)
     if (spi_bus_mutex[device->bus].users == 0)
     {
       OS_MutSemDelete(spi_bus_mutex[device->bus].spi_mutex);
+      OS_MutSemDelete(spi_bus_mutex[device->bus].stats_mutex);
     }
 
     status = close(device->handle);
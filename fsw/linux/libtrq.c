@@ -21,6 +21,46 @@ ivv-itc@lists.nasa.gov
 
 #define TRQ_FNAME_SIZE 50
 
+/* The PWM high time is held by timer 1 of the AXI timer pair */
+#define TRQ_HIGH_TIME_TIMER 1
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ * trq_set_time_high_shadow(): Write a new high time into the load register of the running high time timer. The
+ *                      timer reloads it at the next period boundary, so the output keeps its phase and never
+ *                      glitches. The load register holds the count minus the 2 cycles the AXI timer adds.
+ *
+ * Inputs:              trq_info_t *device      -   TRQ device info structure, PWM running
+ *                      uint32_t    new_time    -   New time high length in nanoseconds, not 0
+ *
+ * Outputs:             returns int32_t         -   TRQ_ERROR on failure, TRQ_SUCCESS on success
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static int32_t trq_set_time_high_shadow(trq_info_t* device, uint32_t new_time)
+{
+    uint64_t counts = ((uint64_t)new_time * device->timer_clock_hz) / 1000000000ULL;
+
+    counts = (counts > 2) ? (counts - 2) : 0;
+
+    if(!device->shadow_selected)
+    {
+        if(ioctl(device->timerfd, TMRCTR_TMR_SELECT, TRQ_HIGH_TIME_TIMER) < 0)
+        {
+            printf("trq_set_time_high: Error selecting trq %d high time timer! \n", device->trq_num); 
+            return TRQ_ERROR; 
+        }
+        device->shadow_selected = true;
+    }
+
+    if(ioctl(device->timerfd, TMRCTR_SET_RESET_VALUE, (long)counts) < 0)
+    {
+        printf("trq_set_time_high: Error setting trq %d high time! \n", device->trq_num); 
+        return TRQ_ERROR; 
+    }
+
+    return TRQ_SUCCESS;
+}
+
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  *
  * trq_set_time_high(): Configure the time high per period in nanoseconds for a TRQ device. Time high lengths
@@ -48,6 +88,18 @@ int32_t trq_set_time_high(trq_info_t* device, uint32_t new_time)
 		return TRQ_TIME_HIGH_VAL_ERR;
 	}
 
+    // A running PWM only needs its load register changed, starting or stopping it needs the full sequence
+    if(device->timer_clock_hz && device->timer_high_ns && new_time)
+    {
+        if(trq_set_time_high_shadow(device, new_time) != TRQ_SUCCESS)
+        {
+            return TRQ_ERROR; 
+        }
+        device->timer_high_ns = new_time;
+        return TRQ_SUCCESS;
+    }
+
+    device->shadow_selected = false;
     ioctl(device->timerfd, TMRCTR_PWM_DISABLE); 
     if(ioctl(device->timerfd, TMRCTR_PWM_SET_HIGH_TIME, new_time) < 0)
     {
@@ -84,6 +136,7 @@ int32_t trq_set_period(trq_info_t* device)
     }
 
     // Make sure timer is disabled first
+    device->shadow_selected = false;
     ioctl(device->timerfd, TMRCTR_PWM_DISABLE); 
 
     if(ioctl(device->timerfd, TMRCTR_PWM_SET_PERIOD, device->timer_period_ns) < 0)
@@ -133,6 +186,41 @@ int32_t trq_set_direction(trq_info_t* device, bool direction)
     return TRQ_SUCCESS;
 }
 
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ * trq_update_pending(): Check whether a glitch-free high time update is still waiting for the period boundary.
+ *
+ * Inputs:              trq_info_t *device      -   TRQ device info structure 
+ *
+ * Outputs:             bool *pending           -   true while the previous update has not been applied
+ *                      returns int32_t         -   TRQ_ERROR on failure, TRQ_SUCCESS on success
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+int32_t trq_update_pending(trq_info_t* device, bool* pending)
+{
+    long update = 0;
+
+    *pending = false;
+    if(!device->enabled)
+    {
+        return TRQ_ERROR; 
+    }
+
+    if(!device->shadow_selected)
+    {
+        return TRQ_SUCCESS; 
+    }
+
+    if(ioctl(device->timerfd, TMRCTR_CHECK_UPDATE, &update) < 0)
+    {
+        printf("trq_update_pending: Error checking trq %d update! \n", device->trq_num); 
+        return TRQ_ERROR; 
+    }
+    *pending = (update != 0);
+
+    return TRQ_SUCCESS;
+}
+
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  *
  * trq_init():          Opens a TRQ device and initializes it. This function can also be
@@ -175,6 +263,7 @@ int32_t trq_init(trq_info_t* device)
             return TRQ_INIT_ERR;
         }
 
+        device->shadow_selected = false;
         device->enabled = true;
     }
 
@@ -198,34 +287,31 @@ int32_t trq_init(trq_info_t* device)
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  *
- * trq_command():   Change TQR period, time high, or direction.
+ * trq_command_ns():    Change TQR time high or direction.
  *
  * Inputs:              trq_info_t* device      -   TQR device info structure to modify
- *                      uint8_t percent_high    -   Percent of the period to be high (0-100)
+ *                      uint32_t time_high_ns   -   Time high per period in nanoseconds (0 to timer_period_ns)
  *                      bool pos_dir            -   Direction - True for positive, False for negative
  *
  * Outputs:             trq_info_t *device      -   Parameters set to new values if successful
  *                      returns int32_t         -   TRQ_ERROR_* type on failure, TRQ_SUCCESS on success
  *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
-int32_t trq_command(trq_info_t *device, uint8_t percent_high, bool pos_dir)
+int32_t trq_command_ns(trq_info_t *device, uint32_t time_high_ns, bool pos_dir)
 {
     int32_t status = TRQ_SUCCESS;
-    uint32_t time_high_ns;
 
     if(!device->enabled)
     {
         status = TRQ_ERROR; 
         return status;
     }
-    
-    // Calculate time high
-    if (percent_high > 100)
+
+    if(time_high_ns > device->timer_period_ns)
     {
-        printf("trq_command: Error setting percent high greater than 100! \n");
-        return TRQ_ERROR;
+        printf("trq_command: Error setting time high greater than the period! \n");
+        return TRQ_TIME_HIGH_VAL_ERR;
     }
-    time_high_ns = device->timer_period_ns * (percent_high / 100.00);
     
     // Change time high? 
     if(device->timer_high_ns != time_high_ns)
@@ -255,6 +341,144 @@ int32_t trq_command(trq_info_t *device, uint8_t percent_high, bool pos_dir)
     return status;
 }
 
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ * trq_command_q16():   Change TQR time high or direction with a Q16 duty cycle, 1/65536 of a period resolution.
+ *
+ * Inputs:              trq_info_t* device      -   TQR device info structure to modify
+ *                      uint32_t duty_q16       -   Fraction of the period to be high (0 to TRQ_DUTY_Q16_ONE)
+ *                      bool pos_dir            -   Direction - True for positive, False for negative
+ *
+ * Outputs:             trq_info_t *device      -   Parameters set to new values if successful
+ *                      returns int32_t         -   TRQ_ERROR_* type on failure, TRQ_SUCCESS on success
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+int32_t trq_command_q16(trq_info_t *device, uint32_t duty_q16, bool pos_dir)
+{
+    uint32_t time_high_ns;
+
+    if(trq_q16_to_ns(device, duty_q16, &time_high_ns) != TRQ_SUCCESS)
+    {
+        return TRQ_ERROR;
+    }
+
+    return trq_command_ns(device, time_high_ns, pos_dir);
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ * trq_command():   Change TQR period, time high, or direction.
+ *
+ * Inputs:              trq_info_t* device      -   TQR device info structure to modify
+ *                      uint8_t percent_high    -   Percent of the period to be high (0-100)
+ *                      bool pos_dir            -   Direction - True for positive, False for negative
+ *
+ * Outputs:             trq_info_t *device      -   Parameters set to new values if successful
+ *                      returns int32_t         -   TRQ_ERROR_* type on failure, TRQ_SUCCESS on success
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+int32_t trq_command(trq_info_t *device, uint8_t percent_high, bool pos_dir)
+{
+    uint32_t time_high_ns;
+
+    if(trq_percent_to_ns(device, percent_high, &time_high_ns) != TRQ_SUCCESS)
+    {
+        return TRQ_ERROR;
+    }
+
+    return trq_command_ns(device, time_high_ns, pos_dir);
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ * trq_command_set_restore(): Put the axes of a failed trq_command_set back to their previous high time and
+ *                      direction, best effort since the failing timer may not respond.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void trq_command_set_restore(trq_cmd_t* cmds, uint8_t count, const uint32_t* old_high_ns, const bool* old_dir)
+{
+    uint8_t i;
+
+    for(i = 0; i < count; i++)
+    {
+        if(cmds[i].device->timer_high_ns != old_high_ns[i])
+        {
+            trq_set_time_high(cmds[i].device, old_high_ns[i]);
+        }
+        if(cmds[i].device->positive_direction != old_dir[i])
+        {
+            trq_set_direction(cmds[i].device, old_dir[i]);
+        }
+    }
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ * trq_command_set():   Command several TRQs together. Every command is validated before any torquer is touched,
+ *                      then the changed high times are written back to back, followed by the changed directions,
+ *                      so the axes switch as close together as the timers allow. Unchanged values cost nothing.
+ *                      Each axis is its own AXI timer, so a changed high time is one ioctl on a running torquer
+ *                      with timer_clock_hz set, and the disable/set/enable sequence otherwise. If a write fails
+ *                      the axes already changed are restored to their previous values.
+ *
+ * Inputs:              trq_cmd_t* cmds         -   Commands, one per torquer
+ *                      uint8_t count           -   Number of commands (up to TRQ_MAX_DEVICES)
+ *
+ * Outputs:             trq_info_t *device      -   Parameters of each commanded device set to new values if successful
+ *                      returns int32_t         -   TRQ_ERROR_* type on failure, TRQ_SUCCESS on success
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+int32_t trq_command_set(trq_cmd_t* cmds, uint8_t count)
+{
+    uint32_t time_high_ns[TRQ_MAX_DEVICES];
+    uint32_t old_high_ns[TRQ_MAX_DEVICES];
+    bool old_dir[TRQ_MAX_DEVICES];
+    uint8_t i;
+
+    if(count > TRQ_MAX_DEVICES)
+    {
+        printf("trq_command_set: Error, more than %d commands! \n", TRQ_MAX_DEVICES);
+        return TRQ_NUM_ERR;
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        if(!cmds[i].device->enabled)
+        {
+            return TRQ_ERROR;
+        }
+        if(trq_q16_to_ns(cmds[i].device, cmds[i].duty_q16, &time_high_ns[i]) != TRQ_SUCCESS)
+        {
+            return TRQ_ERROR;
+        }
+        old_high_ns[i] = cmds[i].device->timer_high_ns;
+        old_dir[i] = cmds[i].device->positive_direction;
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        if((cmds[i].device->timer_high_ns != time_high_ns[i]) &&
+           (trq_set_time_high(cmds[i].device, time_high_ns[i]) != TRQ_SUCCESS))
+        {
+            trq_command_set_restore(cmds, count, old_high_ns, old_dir);
+            return TRQ_ERROR;
+        }
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        if((cmds[i].device->positive_direction != cmds[i].pos_dir) &&
+           (trq_set_direction(cmds[i].device, cmds[i].pos_dir) != TRQ_SUCCESS))
+        {
+            printf("trq_command_set: Error setting trq %d direction! \n", cmds[i].device->trq_num);
+            trq_command_set_restore(cmds, count, old_high_ns, old_dir);
+            return TRQ_ERROR;
+        }
+    }
+
+    return TRQ_SUCCESS;
+}
+
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * 
  *
  * trq_close():         Disables and closes an active TRQ device. 
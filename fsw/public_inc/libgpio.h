@@ -37,6 +37,7 @@ ivv-itc@lists.nasa.gov
 #define GPIO_FD_OPEN_ERR        OS_ERR_FILE
 #define GPIO_WRITE_ERR          -3
 #define GPIO_READ_ERR           -4
+#define GPIO_TIMEOUT_ERR        -5
 
 #define GPIO_INPUT              0
 #define GPIO_OUTPUT             1
@@ -44,24 +45,69 @@ ivv-itc@lists.nasa.gov
 #define GPIO_OPEN               1
 #define GPIO_CLOSED             0
 
+#define GPIO_IF_SYSFS           0   /* /sys/class/gpio, pin is the global gpio number */
+#define GPIO_IF_CHARDEV         1   /* /dev/gpiochipN line request, pin is the line offset on chip */
+
+#define GPIO_CONSUMER           "hwlib"
+
+#define GPIO_GROUP_MAX_PINS     32
+
+#define GPIO_EDGE_NONE          0
+#define GPIO_EDGE_RISING        1
+#define GPIO_EDGE_FALLING       2
+#define GPIO_EDGE_BOTH          (GPIO_EDGE_RISING | GPIO_EDGE_FALLING)
+
+#define GPIO_POLL_MAX_DEVICES   32
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /* Structures */
+typedef struct
+{
+    uint64_t timestamp_ns;       /* CLOCK_MONOTONIC time of the edge */
+    uint32_t seqno;              /* event sequence number on this pin */
+    uint32_t pin;                /* pin the event occurred on */
+    uint8_t  edge;               /* GPIO_EDGE_RISING or GPIO_EDGE_FALLING */
+} gpio_event_t;
+
+typedef void (*gpio_event_cb_t)(const gpio_event_t* event, void* arg);
+
 typedef struct
 {
     uint32_t pin;                /* pin number to initialize */
-    int32_t  handle;             /* handle to device */ 
+    int32_t  handle;             /* handle to device, the line request or value file descriptor */ 
     uint8_t  direction;          /* in or out */
     uint8_t  isOpen;             
+    uint32_t chip;               /* gpiochip number, used with GPIO_IF_CHARDEV */
+    uint8_t  interface;          /* GPIO_IF_*, defaults to sysfs */
+    uint8_t  edge;               /* GPIO_EDGE_* reported as events, inputs only */
+    uint32_t debounce_us;        /* debounce period for edge events, 0 to disable */
+    gpio_event_cb_t callback;    /* called by gpio_poll_events for each event */
+    void*    callback_arg;       /* passed to callback */
+    uint32_t seqno;              /* backend state, events consumed on this pin */
 } gpio_info_t;
 
+typedef struct
+{
+    uint32_t pins[GPIO_GROUP_MAX_PINS]; /* pin numbers, bit i of a value maps to pins[i] */
+    uint8_t  num_pins;           /* number of pins in use */
+    int32_t  handle;             /* handle to the line request */
+    uint8_t  direction;          /* in or out, shared by all pins */
+    uint8_t  isOpen;
+    uint32_t chip;               /* gpiochip number, used with GPIO_IF_CHARDEV */
+    uint8_t  interface;          /* GPIO_IF_*, defaults to sysfs */
+    int32_t  handles[GPIO_GROUP_MAX_PINS]; /* per pin handles when the pins are accessed one by one */
+} gpio_group_t;
+
 /* Prototypes */
 void gpio_dummy(void);
 
 /*
  * Initialize GPIO pin
+ * On linux with interface GPIO_IF_CHARDEV the line offset pin is requested once from
+ * /dev/gpiochip<chip> and held until gpio_close, otherwise pin is exported through sysfs
  * @param device - GPIO device information
  * @return Returns GPIO_SUCCESS or an error code defined above
  */
@@ -83,6 +129,31 @@ int32_t gpio_read(gpio_info_t* device, uint8_t* value);
  */
 int32_t gpio_write(gpio_info_t* device, uint8_t value);
 
+/*
+ * Wait for the next edge event on a pin initialized with `edge` set
+ * @param device - GPIO device information
+ * @param event - event information
+ * @param timeout_ms - milliseconds to wait, negative waits forever
+ * @return Returns GPIO_SUCCESS, GPIO_TIMEOUT_ERR or an error code defined above
+ */
+int32_t gpio_wait_event(gpio_info_t* device, gpio_event_t* event, int32_t timeout_ms);
+
+/*
+ * Wait for edge events on several pins and call each pin's callback for every event
+ * @param devices - array of GPIO device information pointers
+ * @param count - number of devices, up to GPIO_POLL_MAX_DEVICES
+ * @param timeout_ms - milliseconds to wait, negative waits forever
+ * @return Returns the number of events dispatched (0 on timeout) or an error code defined above
+ */
+int32_t gpio_poll_events(gpio_info_t** devices, uint32_t count, int32_t timeout_ms);
+
+/*
+ * Pollable file descriptor for the edge events of a pin, for use in an app's own poll loop
+ * @param device - GPIO device information
+ * @return Returns the file descriptor or GPIO_ERROR if events are not supported
+ */
+int32_t gpio_event_fd(gpio_info_t* device);
+
 /*
  * Close GPIO handle
  * @param device - GPIO device information
@@ -90,6 +161,37 @@ int32_t gpio_write(gpio_info_t* device, uint8_t value);
  */
 int32_t gpio_close(gpio_info_t* device);
 
+/*
+ * Initialize a group of GPIO pins that are read and written together
+ * @param group - GPIO group information
+ * @return Returns GPIO_SUCCESS or an error code defined above
+ */
+int32_t gpio_group_init(gpio_group_t* group);
+
+/*
+ * Read all pins of a group
+ * @param group - GPIO group information
+ * @param values - bitmask of the pin values, bit i is pins[i]
+ * @return Returns GPIO_SUCCESS or an error code defined above
+ */
+int32_t gpio_group_read(gpio_group_t* group, uint32_t* values);
+
+/*
+ * Write the pins of a group selected by `mask`, the others keep their value
+ * @param group - GPIO group information
+ * @param values - bitmask of the pin values, bit i is pins[i]
+ * @param mask - bitmask of the pins to write
+ * @return Returns GPIO_SUCCESS or an error code defined above
+ */
+int32_t gpio_group_write(gpio_group_t* group, uint32_t values, uint32_t mask);
+
+/*
+ * Close GPIO group handle
+ * @param group - GPIO group information
+ * @return Returns GPIO_SUCCESS or an error code defined above
+ */
+int32_t gpio_group_close(gpio_group_t* group);
+
 #ifdef __cplusplus
 }
 #endif
@@ -55,14 +55,28 @@ ivv-itc@lists.nasa.gov
 /* Number of I2C busses */
 #define NUM_I2C                 2
 
-/* Max size of I2C transaction */
-#define I2C_MAX_BYTES           128
+/* Max size of one I2C message, the largest transfer i2c-dev accepts */
+#define I2C_MAX_BYTES           8192
+
+/* Max messages in one combined transaction, I2C_RDWR_IOCTL_MAX_MSGS in i2c-dev */
+#define I2C_MAX_MSGS            42
+
+/* Max data bytes in an SMBus block transfer */
+#define SMBUS_BLOCK_MAX         32
+
+/* I2C scheduler limits */
+#define I2C_SCHED_MAX_SLOTS     16
+#define I2C_SCHED_MAX_LEN       32
+#define I2C_SCHED_NO_RETRY      0x01    /* slot flag, never read the slot twice in one run */
 
 /* Defines */
 #define I2C_SUCCESS            OS_SUCCESS
 #define I2C_ERROR              OS_ERROR
 #define I2C_FD_OPEN_ERR        OS_ERR_FILE
 
+/* No slave address selected on the bus handle yet */
+#define I2C_ADDR_NONE          -1
+
 /*
 ** I2C bus info struct
 */
@@ -72,8 +86,58 @@ typedef struct
     int32_t  addr;     /* slave address */
     uint8_t  isOpen;   /* port status */
     uint32_t speed;    
+    uint8_t  retries;  /* adapter retries on arbitration loss, set with i2c_master_config */
+    uint16_t timeout;  /* timeout in ms currently applied to the handle, 0 while the driver default is in use */
+    uint8_t  recover;  /* nonzero to run bus recovery on scl_pin/sda_pin when a transaction times out, set with i2c_master_config */
+    uint32_t scl_pin;  /* sysfs gpio number muxed with SCL, used for bus recovery */
+    uint32_t sda_pin;  /* sysfs gpio number muxed with SDA, used for bus recovery */
+    uint8_t  pec;      /* nonzero to append and verify the SMBus packet error code, cleared by i2c_master_init */
+    uint8_t  pec_set;  /* PEC state currently applied to the handle, managed by hwlib */
+    int32_t  cur_addr; /* slave address currently selected on the handle, I2C_ADDR_NONE if unknown, managed by hwlib */
 } i2c_bus_info_t;
 
+/*
+** I2C batch operation, a write and/or read to one slave
+*/
+typedef struct
+{
+    uint8_t  addr;     /* slave address, not bit-shifted */
+    void*    txbuf;    /* data to write, or NULL */
+    uint16_t txlen;    /* length of tx data, 0 for a read only operation */
+    void*    rxbuf;    /* buffer for read data, or NULL */
+    uint16_t rxlen;    /* length of rx data, 0 for a write only operation */
+} i2c_batch_op_t;
+
+/*
+** I2C scheduler slot, a register read repeated every period
+** The latest result is double buffered so readers never block the scheduler
+*/
+typedef struct
+{
+    uint8_t  addr;                            /* slave address, not bit-shifted */
+    uint8_t  reg;                             /* register written before the read */
+    uint16_t len;                             /* bytes to read */
+    uint32_t period_ms;                       /* poll period in milliseconds */
+    uint64_t next_ms;                         /* monotonic time the slot is next due */
+    int32_t  status;                          /* status of the latest poll */
+    uint32_t seq;                             /* bumped on every published result */
+    uint8_t  current;                         /* buffer holding the latest result */
+    uint8_t  data[2][I2C_SCHED_MAX_LEN];
+    uint64_t timestamp_ns[2];                 /* monotonic completion time of each buffer */
+    uint8_t  flags;                           /* I2C_SCHED_* slot flags */
+} i2c_sched_slot_t;
+
+/*
+** I2C scheduler, one per bus
+*/
+typedef struct
+{
+    i2c_bus_info_t*  device;                  /* bus the slots are polled on */
+    uint16_t         timeout;                 /* timeout passed to each transaction */
+    uint32_t         num_slots;
+    i2c_sched_slot_t slot[I2C_SCHED_MAX_SLOTS];
+} i2c_sched_t;
+
 /* 
  * Initialize I2C handle as Master with bus speed
  *
@@ -83,19 +147,37 @@ typedef struct
 */
 int32_t i2c_master_init(i2c_bus_info_t* device);
 
+/*
+ * Configure adapter retries and bus recovery, call after i2c_master_init
+ * i2c_master_init turns both off, so apps that only set handle and speed are unaffected
+ *
+ * @param device Which I2C bus (if more than one exists)
+ * @param retries Retries on arbitration loss (I2C_RETRIES on linux), 0 keeps the driver default
+ * @param recover Nonzero to run i2c_bus_recover when a transaction times out or the adapter reports the bus busy
+ * @param scl_pin sysfs gpio number muxed with SCL
+ * @param sda_pin sysfs gpio number muxed with SDA
+ * @return Returns error code: I2C_SUCCESS, or I2C_ERROR
+*/
+int32_t i2c_master_config(i2c_bus_info_t* device, uint8_t retries, uint8_t recover, uint32_t scl_pin, uint32_t sda_pin);
+
 /**
  * Execute an I2C master write and slave read in one transaction
  *
+ * The timeout of this and every other transaction below is in milliseconds. It used to be
+ * documented as ticks and was ignored; on linux it is now applied to the adapter with
+ * I2C_TIMEOUT (in 10 ms steps) and stays in effect for later transactions on the handle,
+ * so callers that pass tick counts must convert them. It is ignored on nos-linux.
+ *
  * @param device Which I2C bus (if more than one exists)
  * @param addr I2C address, not bit-shifted
  * @param txbuf pointer to tx data
  * @param txlen length of tx data
  * @param rxbuf pointer to rx data
  * @param rxlen length of rx data
- * @param timeout Number of ticks to wait for a frame
+ * @param timeout Timeout in milliseconds, 0 keeps the bus timeout unchanged
  * @return Returns error code: I2C_SUCCESS if a frame is received, or I2C_ERROR if timed out or if handle is not a valid device
  */
-int32_t i2c_master_transaction(i2c_bus_info_t* device, uint8_t addr, void * txbuf, uint8_t txlen, void * rxbuf, uint8_t rxlen, uint16_t timeout);
+int32_t i2c_master_transaction(i2c_bus_info_t* device, uint8_t addr, void * txbuf, uint16_t txlen, void * rxbuf, uint16_t rxlen, uint16_t timeout);
 
 /**
  * Execute an I2C slave read
@@ -104,10 +186,10 @@ int32_t i2c_master_transaction(i2c_bus_info_t* device, uint8_t addr, void * txbu
  * @param addr I2C address, not bit-shifted
  * @param rxbuf pointer to rx data
  * @param rxlen length of rx data
- * @param timeout Number of ticks to wait for a frame
+ * @param timeout Timeout in milliseconds, 0 keeps the bus timeout unchanged
  * @return Returns error code: I2C_SUCCESS if a frame is received, or I2C_ERROR if timed out or if handle is not a valid device
  */
-int32_t i2c_read_transaction(i2c_bus_info_t* device, uint8_t addr, void * rxbuf, uint8_t rxlen, uint8_t timeout);
+int32_t i2c_read_transaction(i2c_bus_info_t* device, uint8_t addr, void * rxbuf, uint16_t rxlen, uint16_t timeout);
 
 /**
  * Execute an I2C master write
@@ -116,22 +198,202 @@ int32_t i2c_read_transaction(i2c_bus_info_t* device, uint8_t addr, void * rxbuf,
  * @param addr I2C address, not bit-shifted
  * @param txbuf pointer to tx data
  * @param txlen length of tx data
- * @param timeout Number of ticks to wait for a frame
+ * @param timeout Timeout in milliseconds, 0 keeps the bus timeout unchanged
  * @return Returns error code: I2C_SUCCESS if a frame is received, or I2C_ERROR if timed out or if handle is not a valid device
  */
-int32_t i2c_write_transaction(i2c_bus_info_t* device, uint8_t addr, void * txbuf, uint8_t txlen, uint8_t timeout);
+int32_t i2c_write_transaction(i2c_bus_info_t* device, uint8_t addr, void * txbuf, uint16_t txlen, uint16_t timeout);
 
 /**
  * Execute multiple I2C transactions without stops
  *
  * @param device Which I2C bus (if more than one exists)
- * @param addr I2C address, not bit-shifted
+ * @param addr Unused, the address of each message is used
  * @param i2c_rdwr_ioctl_data structure containing multiple messages
- * @param timeout Number of ticks to wait for a frame
+ * @param timeout Timeout in milliseconds, 0 keeps the bus timeout unchanged
  * @return Returns error code: I2C_SUCCESS if a frame is received, or I2C_ERROR if timed out or if handle is not a valid device
  */
 int32_t i2c_multiple_transaction(i2c_bus_info_t* device, uint8_t addr, struct i2c_rdwr_ioctl_data* rdwr_data, uint16_t timeout);
 
+/**
+ * Execute a list of I2C operations, possibly to different slaves, as one combined transaction
+ *
+ * Each operation writes txbuf and then reads rxbuf with a repeated start in between.
+ * On linux all operations are packed into as few I2C_RDWR ioctls as I2C_MAX_MSGS
+ * allows, with repeated starts between operations and a single stop at the end.
+ *
+ * @param device Which I2C bus (if more than one exists)
+ * @param ops array of operations to execute in order
+ * @param count number of operations
+ * @param timeout Timeout in milliseconds, 0 keeps the bus timeout unchanged
+ * @return Returns error code: I2C_SUCCESS if all operations complete, or I2C_ERROR if any fails or if handle is not a valid device
+ */
+int32_t i2c_batch_transaction(i2c_bus_info_t* device, i2c_batch_op_t* ops, uint32_t count, uint16_t timeout);
+
+/**
+ * Stream a large block out of a memory device such as an EEPROM or FRAM
+ *
+ * The memory offset is written once per combined transaction and followed by page sized
+ * reads chained with repeated starts, relying on the device advancing its address pointer.
+ * Up to I2C_MAX_MSGS - 1 pages are read per combined transaction.
+ *
+ * @param device Which I2C bus (if more than one exists)
+ * @param addr I2C address, not bit-shifted
+ * @param offset memory offset to start reading from
+ * @param offset_len number of offset bytes the device expects (1 to 4), sent most significant byte first
+ * @param rxbuf pointer to rx data
+ * @param rxlen length of rx data
+ * @param page_size bytes per read message, 0 for I2C_MAX_BYTES
+ * @param timeout Timeout in milliseconds for each combined transaction, 0 keeps the bus timeout unchanged
+ * @return Returns error code: I2C_SUCCESS if the whole block was read, or I2C_ERROR if any transaction fails
+ */
+int32_t i2c_stream_read(i2c_bus_info_t* device, uint8_t addr, uint32_t offset, uint8_t offset_len, void* rxbuf, uint32_t rxlen, uint16_t page_size, uint16_t timeout);
+
+/**
+ * SMBus read byte data, write the command code and read one data byte
+ *
+ * @param device Which I2C bus (if more than one exists)
+ * @param addr I2C address, not bit-shifted
+ * @param cmd SMBus command code
+ * @param value pointer to the read byte
+ * @param timeout Timeout in milliseconds, 0 keeps the bus timeout unchanged
+ * @return Returns error code: I2C_SUCCESS, or I2C_ERROR if the transfer fails or the PEC does not match
+ */
+int32_t smbus_read_byte_data(i2c_bus_info_t* device, uint8_t addr, uint8_t cmd, uint8_t* value, uint16_t timeout);
+
+/**
+ * SMBus write byte data, write the command code and one data byte
+ *
+ * @param device Which I2C bus (if more than one exists)
+ * @param addr I2C address, not bit-shifted
+ * @param cmd SMBus command code
+ * @param value byte to write
+ * @param timeout Timeout in milliseconds, 0 keeps the bus timeout unchanged
+ * @return Returns error code: I2C_SUCCESS, or I2C_ERROR if the transfer fails
+ */
+int32_t smbus_write_byte_data(i2c_bus_info_t* device, uint8_t addr, uint8_t cmd, uint8_t value, uint16_t timeout);
+
+/**
+ * SMBus read word data, write the command code and read a little endian word
+ *
+ * @param device Which I2C bus (if more than one exists)
+ * @param addr I2C address, not bit-shifted
+ * @param cmd SMBus command code
+ * @param value pointer to the read word
+ * @param timeout Timeout in milliseconds, 0 keeps the bus timeout unchanged
+ * @return Returns error code: I2C_SUCCESS, or I2C_ERROR if the transfer fails or the PEC does not match
+ */
+int32_t smbus_read_word_data(i2c_bus_info_t* device, uint8_t addr, uint8_t cmd, uint16_t* value, uint16_t timeout);
+
+/**
+ * SMBus write word data, write the command code and a little endian word
+ *
+ * @param device Which I2C bus (if more than one exists)
+ * @param addr I2C address, not bit-shifted
+ * @param cmd SMBus command code
+ * @param value word to write
+ * @param timeout Timeout in milliseconds, 0 keeps the bus timeout unchanged
+ * @return Returns error code: I2C_SUCCESS, or I2C_ERROR if the transfer fails
+ */
+int32_t smbus_write_word_data(i2c_bus_info_t* device, uint8_t addr, uint8_t cmd, uint16_t value, uint16_t timeout);
+
+/**
+ * SMBus block read, write the command code and read a byte count followed by that many bytes
+ *
+ * @param device Which I2C bus (if more than one exists)
+ * @param addr I2C address, not bit-shifted
+ * @param cmd SMBus command code
+ * @param data pointer to rx data, at least SMBUS_BLOCK_MAX bytes
+ * @param len pointer to the number of bytes read
+ * @param timeout Timeout in milliseconds, 0 keeps the bus timeout unchanged
+ * @return Returns error code: I2C_SUCCESS, or I2C_ERROR if the transfer fails or the PEC does not match
+ */
+int32_t smbus_block_read(i2c_bus_info_t* device, uint8_t addr, uint8_t cmd, uint8_t* data, uint8_t* len, uint16_t timeout);
+
+/**
+ * Update an SMBus packet error code (CRC-8, polynomial x^8 + x^2 + x + 1) over a buffer
+ *
+ * The PEC covers every byte on the bus including the address bytes, (addr << 1) for writes and
+ * (addr << 1) | 1 for reads.
+ *
+ * @param crc running PEC, 0 for the first buffer
+ * @param data bytes to add
+ * @param len number of bytes
+ * @return Returns the updated PEC
+ */
+uint8_t smbus_pec(uint8_t crc, const uint8_t* data, uint32_t len);
+
+/**
+ * Initialize an I2C scheduler for an open bus
+ *
+ * @param sched scheduler to initialize
+ * @param device Which I2C bus (if more than one exists)
+ * @param timeout Timeout in milliseconds for each combined transaction, 0 keeps the bus timeout unchanged
+ * @return Returns error code: I2C_SUCCESS, or I2C_ERROR if the bus is not open
+ */
+int32_t i2c_sched_init(i2c_sched_t* sched, i2c_bus_info_t* device, uint16_t timeout);
+
+/**
+ * Register a recurring register read with the scheduler
+ *
+ * Slots must be registered before the task calling i2c_sched_run starts.
+ *
+ * @param sched scheduler to add the slot to
+ * @param addr I2C address, not bit-shifted
+ * @param reg register written before each read
+ * @param len number of bytes to read, at most I2C_SCHED_MAX_LEN
+ * @param period_ms poll period in milliseconds
+ * @param slot_id returned id used with i2c_sched_read
+ * @return Returns error code: I2C_SUCCESS, or I2C_ERROR if the slot is invalid or the scheduler is full
+ */
+int32_t i2c_sched_add(i2c_sched_t* sched, uint8_t addr, uint8_t reg, uint16_t len, uint32_t period_ms, uint32_t* slot_id);
+
+/**
+ * Set the flags of a slot, e.g. I2C_SCHED_NO_RETRY for clear-on-read registers
+ *
+ * Like i2c_sched_add, call before the task calling i2c_sched_run starts.
+ *
+ * @param sched scheduler the slot belongs to
+ * @param slot_id id returned by i2c_sched_add
+ * @param flags I2C_SCHED_* slot flags
+ * @return Returns error code: I2C_SUCCESS, or I2C_ERROR if the slot is invalid
+ */
+int32_t i2c_sched_set_flags(i2c_sched_t* sched, uint32_t slot_id, uint8_t flags);
+
+/**
+ * Poll every due slot, intended to be called from one task at the bus tick rate
+ *
+ * All due slots are packed into one i2c_batch_transaction. If the combined transaction
+ * fails, the due slots are retried one at a time so a single bad slave only fails its own slot.
+ * The combined transaction does not report which reads completed before the failure, so
+ * a retried slot may be read twice; slots flagged I2C_SCHED_NO_RETRY are failed instead.
+ *
+ * @param sched scheduler to run
+ * @return Returns error code: I2C_SUCCESS if every due slot was read, or I2C_ERROR if any failed
+ */
+int32_t i2c_sched_run(i2c_sched_t* sched);
+
+/**
+ * Copy the latest result of a slot
+ *
+ * @param sched scheduler the slot belongs to
+ * @param slot_id id returned by i2c_sched_add
+ * @param rxbuf pointer to rx data
+ * @param rxlen length of rx data, at most the slot length
+ * @param timestamp_ns returned monotonic completion time of the result, may be NULL
+ * @return Returns error code: status of the latest poll, or I2C_ERROR if the slot has never been read
+ */
+int32_t i2c_sched_read(i2c_sched_t* sched, uint32_t slot_id, void* rxbuf, uint16_t rxlen, uint64_t* timestamp_ns);
+
+/**
+ * Recover a bus held low by a slave by clocking SCL and issuing a STOP on the recovery gpio pins
+ *
+ * Runs automatically before a timed out transaction returns its error when device->recover is set.
+ *
+ * @param device Which I2C bus (if more than one exists)
+ * @return Returns error code: I2C_SUCCESS if the bus is free or recovery is disabled, or I2C_ERROR if SDA stays low
+ */
+int32_t i2c_bus_recover(i2c_bus_info_t* device);
+
 /**
  * Close an I2C bus
  *
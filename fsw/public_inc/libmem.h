@@ -20,6 +20,7 @@ ivv-itc@lists.nasa.gov
 
 #include "hwlib.h"
 #include <stdint.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -28,12 +29,197 @@ extern "C" {
 /* Defines */
 #define MEM_SUCCESS            OS_SUCCESS
 #define MEM_ERROR              OS_ERROR
+#define MEM_TIMEOUT_ERR        -5
+
+#define MEM_OPEN               1
+#define MEM_CLOSED             0
+
+/* widest access used by the burst copies */
+#if UINTPTR_MAX > 0xFFFFFFFFUL
+#define MEM_BURST_MAX_WIDTH    8
+#else
+#define MEM_BURST_MAX_WIDTH    4
+#endif
+
+/* Structures */
+typedef struct
+{
+    uint32_t          base;      /* physical base address of the window */
+    uint32_t          length;    /* length of the window in bytes */
+    volatile uint8_t* addr;      /* mapped address of base */
+    void*             map;       /* start of the underlying mapping */
+    size_t            map_length;/* length of the underlying mapping */
+    int32_t           handle;    /* backend handle */
+    uint8_t           isOpen;
+} mem_region_t;
+
+typedef struct
+{
+    char              name[32];  /* u-dma-buf device name, e.g. "udmabuf0" */
+    void*             addr;      /* cacheable CPU mapping of the buffer */
+    uint64_t          phys_addr; /* physical address to program into the DMA engine */
+    size_t            size;      /* size of the buffer in bytes */
+    int32_t           handle;    /* backend handle */
+    uint8_t           isOpen;
+} mem_dma_buf_t;
+
+typedef struct
+{
+    uint32_t          uio;       /* N of /dev/uioN */
+    int32_t           handle;    /* backend handle */
+    uint32_t          count;     /* interrupt count seen by the last wait */
+    void*             shm;       /* backend state */
+    uint8_t           isOpen;
+} mem_uio_t;
 
 void mem_dummy(void);
 
+/*
+ * Map a physical address window once for register access without syscalls
+ * @param base - physical base address
+ * @param length - length of the window in bytes
+ * @param region - region information, filled in on success
+ * @return Returns MEM_SUCCESS or MEM_ERROR
+ */
+int32_t mem_region_open(uint32_t base, uint32_t length, mem_region_t* region);
+
+/*
+ * Unmap a region
+ * @param region - region information
+ * @return Returns MEM_SUCCESS or MEM_ERROR
+ */
+int32_t mem_region_close(mem_region_t* region);
+
+/*
+ * Register access of exactly the given width through an open region,
+ * `offset` must be aligned to the access width and inside the window
+ */
+static inline uint8_t mem_region_read8(const mem_region_t* region, uint32_t offset)
+{
+    return *(volatile uint8_t*) (region->addr + offset);
+}
+
+static inline uint16_t mem_region_read16(const mem_region_t* region, uint32_t offset)
+{
+    return *(volatile uint16_t*) (region->addr + offset);
+}
+
+static inline uint32_t mem_region_read32(const mem_region_t* region, uint32_t offset)
+{
+    return *(volatile uint32_t*) (region->addr + offset);
+}
+
+static inline uint64_t mem_region_read64(const mem_region_t* region, uint32_t offset)
+{
+    return *(volatile uint64_t*) (region->addr + offset);
+}
+
+static inline void mem_region_write8(const mem_region_t* region, uint32_t offset, uint8_t value)
+{
+    *(volatile uint8_t*) (region->addr + offset) = value;
+}
+
+static inline void mem_region_write16(const mem_region_t* region, uint32_t offset, uint16_t value)
+{
+    *(volatile uint16_t*) (region->addr + offset) = value;
+}
+
+static inline void mem_region_write32(const mem_region_t* region, uint32_t offset, uint32_t value)
+{
+    *(volatile uint32_t*) (region->addr + offset) = value;
+}
+
+static inline void mem_region_write64(const mem_region_t* region, uint32_t offset, uint64_t value)
+{
+    *(volatile uint64_t*) (region->addr + offset) = value;
+}
+
+/*
+ * Copy a block out of a region using the widest aligned accesses, narrower ones only at unaligned edges
+ * @param region - open region
+ * @param offset - byte offset into the window
+ * @param out - destination buffer, no alignment required
+ * @param length - number of bytes
+ * @return Returns MEM_SUCCESS or MEM_ERROR if the block is outside the window
+ */
+int32_t mem_region_copy_from(const mem_region_t* region, uint32_t offset, void* out, uint32_t length);
+
+/*
+ * Copy a block into a region using the widest aligned accesses, narrower ones only at unaligned edges
+ * @param region - open region
+ * @param offset - byte offset into the window
+ * @param in - source buffer, no alignment required
+ * @param length - number of bytes
+ * @return Returns MEM_SUCCESS or MEM_ERROR if the block is outside the window
+ */
+int32_t mem_region_copy_to(const mem_region_t* region, uint32_t offset, const void* in, uint32_t length);
+
 int32_t devmem_write(uint32_t addr, uint8_t *in, int32_t length); 
 int32_t devmem_read(uint32_t addr, uint8_t *out, int32_t length); 
 
+/*
+ * Map a physically contiguous DMA buffer allocated by the u-dma-buf driver
+ * @param name - device name, the buffer is /dev/<name>
+ * @param buf - buffer information, filled in on success
+ * @return Returns MEM_SUCCESS or MEM_ERROR
+ */
+int32_t mem_dma_open(const char* name, mem_dma_buf_t* buf);
+
+/*
+ * Unmap a DMA buffer
+ * @param buf - buffer information
+ * @return Returns MEM_SUCCESS or MEM_ERROR
+ */
+int32_t mem_dma_close(mem_dma_buf_t* buf);
+
+/*
+ * Hand part of the buffer to the CPU after the device wrote it, invalidating stale cache lines
+ * @param buf - buffer information
+ * @param offset - byte offset of the synced part
+ * @param length - length of the synced part
+ * @return Returns MEM_SUCCESS or MEM_ERROR
+ */
+int32_t mem_dma_sync_for_cpu(mem_dma_buf_t* buf, size_t offset, size_t length);
+
+/*
+ * Hand part of the buffer to the device after the CPU wrote it, flushing dirty cache lines
+ * @param buf - buffer information
+ * @param offset - byte offset of the synced part
+ * @param length - length of the synced part
+ * @return Returns MEM_SUCCESS or MEM_ERROR
+ */
+int32_t mem_dma_sync_for_device(mem_dma_buf_t* buf, size_t offset, size_t length);
+
+/*
+ * Open a UIO device to wait for its interrupt
+ * @param uio - N of /dev/uioN
+ * @param device - UIO information, filled in on success
+ * @return Returns MEM_SUCCESS or MEM_ERROR
+ */
+int32_t mem_uio_open(uint32_t uio, mem_uio_t* device);
+
+/*
+ * Unmask the UIO interrupt, needed again after every interrupt
+ * @param device - UIO information
+ * @return Returns MEM_SUCCESS or MEM_ERROR
+ */
+int32_t mem_uio_irq_enable(mem_uio_t* device);
+
+/*
+ * Wait for the next UIO interrupt, e.g. a DMA completion
+ * @param device - UIO information, count is updated on success
+ * @param timeout_ms - milliseconds to wait, negative waits forever
+ * @return Returns MEM_SUCCESS, MEM_TIMEOUT_ERR or MEM_ERROR
+ */
+int32_t mem_uio_wait(mem_uio_t* device, int32_t timeout_ms);
+
+/*
+ * Close a UIO device
+ * @param device - UIO information
+ * @return Returns MEM_SUCCESS or MEM_ERROR
+ */
+int32_t mem_uio_close(mem_uio_t* device);
+
 #ifdef __cplusplus
 }
 #endif
@@ -8,6 +8,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <netinet/in.h>
 
 /* Defines */
 #define SOCKET_SUCCESS             OS_SUCCESS
@@ -21,6 +22,17 @@
 #define SOCKET_SEND_ERR            -8 
 #define SOCKET_CLOSE_ERR           -9
 #define SOCKET_TRY_AGAIN           -10
+#define SOCKET_LOOP_ERR            -11
+
+#define SOCKET_LOOP_MAX_SOCKETS    64
+#define SOCKET_BATCH_MAX           64     // Datagrams moved per sendmmsg/recvmmsg call
+
+/* Event loop interest and ready flags */
+#define SOCKET_EVENT_READ          0x01   // data (or a closed peer) to recv
+#define SOCKET_EVENT_WRITE         0x02   // room to send, or a non-blocking connect finished
+#define SOCKET_EVENT_ACCEPT        0x04   // a pending connection on a listening socket
+#define SOCKET_EVENT_HANGUP        0x08   // reported only, the peer closed the connection
+#define SOCKET_EVENT_ERROR         0x10   // reported only, an error is pending on the socket
 
 /* Types */
 typedef enum {
@@ -53,6 +65,45 @@ typedef struct {
     bool       connected;         // Is the stream socket in a connected state?
 } socket_info_t;
 
+/* Pre-resolved datagram peer, see socket_addr_resolve */
+typedef struct {
+    struct sockaddr_in addr;
+} socket_addr_t;
+
+/* One datagram of a socket_send_batch or socket_recv_batch */
+typedef struct {
+    uint8_t*       buffer;
+    size_t         buflen;            // Bytes to send, or size of the receive buffer
+    size_t         length;            // Bytes sent or received
+    socket_addr_t* addr;              // Send: destination, NULL for the peer of a connected socket; Recv: filled with the source (optional)
+    bool           truncated;         // Recv: the datagram was longer than buflen and was cut to length
+} socket_datagram_t;
+
+/* Called from socket_loop_wait with the ready SOCKET_EVENT_* flags of a registered socket */
+typedef void (*socket_event_cb_t)(socket_info_t* socket_info, uint32_t events, void* arg);
+
+typedef struct {
+    socket_info_t*    socket_info;       // Registered socket
+    uint32_t          events;            // Ready SOCKET_EVENT_* flags
+    void*             arg;               // Argument given to socket_loop_add
+} socket_event_t;
+
+typedef struct {
+    socket_info_t*    socket_info;       // NULL when the entry is free
+    int               sockfd;            // Descriptor registered with epoll
+    uint32_t          interest;          // SOCKET_EVENT_READ, WRITE and/or ACCEPT
+    socket_event_cb_t callback;          // Optional
+    void*             arg;
+    bool              released;          // Removed during a wait, reusable once the wait returns
+} socket_loop_entry_t;
+
+typedef struct {
+    int                 epfd;            // epoll instance
+    uint32_t            num_sockets;     // Registered sockets
+    bool                dispatching;     // Inside socket_loop_wait
+    socket_loop_entry_t entry[SOCKET_LOOP_MAX_SOCKETS];
+} socket_loop_t;
+
 /* Function Prototypes */
 void socket_dummy(void);
 int32_t socket_create(socket_info_t* socket_info);
@@ -62,6 +113,19 @@ int32_t socket_connect(socket_info_t* socket_info, char* remote_ip_address, int
 int32_t socket_send(socket_info_t* socket_info, uint8_t* buffer, size_t buflen, size_t* bytes_sent, char* remote_ip_address, int remote_port_num);
 int32_t socket_recv(socket_info_t* socket_info, uint8_t* buffer, size_t buflen, size_t* bytes_recvd);
 int32_t socket_close(socket_info_t* socket_info);
+int32_t socket_accept_client(socket_info_t* server_info, socket_info_t* client_info);
+int32_t socket_addr_resolve(socket_addr_t* addr, const char* host, int port_num);
+int32_t socket_send_to(socket_info_t* socket_info, uint8_t* buffer, size_t buflen, size_t* bytes_sent, const socket_addr_t* addr);
+int32_t socket_send_batch(socket_info_t* socket_info, socket_datagram_t* datagrams, uint32_t count, uint32_t* num_sent);
+int32_t socket_recv_batch(socket_info_t* socket_info, socket_datagram_t* datagrams, uint32_t count, uint32_t* num_recvd);
 int32_t HostToIp(const char * hostname, char* ip);
 
+/* Event loop, one epoll wait for all registered sockets */
+int32_t socket_loop_init(socket_loop_t* loop);
+int32_t socket_loop_add(socket_loop_t* loop, socket_info_t* socket_info, uint32_t interest, socket_event_cb_t callback, void* arg);
+int32_t socket_loop_modify(socket_loop_t* loop, socket_info_t* socket_info, uint32_t interest);
+int32_t socket_loop_remove(socket_loop_t* loop, socket_info_t* socket_info);
+int32_t socket_loop_wait(socket_loop_t* loop, socket_event_t* events, uint32_t max_events, int32_t timeout_ms, uint32_t* num_events);
+int32_t socket_loop_close(socket_loop_t* loop);
+
 #endif
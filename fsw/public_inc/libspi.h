@@ -72,16 +72,42 @@ ivv-itc@lists.nasa.gov
 #define SPI_ERR_RD_SD_HZ   		-11
 #define SPI_ERR_IOC_MSG	   		-12
 #define SPI_ERR_MUTEX_CREATE 	-13
+#define SPI_ERR_INVAL_BUS  		-14
 
 #define MAX_SPI_BUSES        		3
+#define MAX_SPI_CHIP_SELECTS 		10
+#define MAX_SPI_TRANSFERS    		16
+
+/* Fixed device index of a bus and chip select pair */
+#define SPI_DEVICE_INDEX(bus, cs)	(((bus) * MAX_SPI_CHIP_SELECTS) + (cs))
+
+#define SPI_BUS_FREE         		-1
 
 /* 
 ** Structures
 */
+typedef struct
+{
+	uint32_t hold_count;     /* number of completed select/unselect holds */
+	uint32_t overrun_count;  /* holds that exceeded the bus max hold time */
+	uint64_t total_hold_ns;  /* accumulated hold time */
+	uint64_t max_hold_ns;    /* longest single hold */
+} spi_hold_stats_t;
+
+typedef struct
+{
+	int32_t          holder;        /* chip select holding the bus, or SPI_BUS_FREE */
+	uint64_t         hold_start_ns; /* monotonic time the holder took the bus */
+	uint32_t         max_hold_us;   /* warn when a hold exceeds this, 0 disables */
+	spi_hold_stats_t cs[MAX_SPI_CHIP_SELECTS];
+} spi_bus_stats_t;
+
 typedef struct 
 {
-	uint32_t spi_mutex;
-	uint8_t  users;
+	uint32_t        spi_mutex;
+	uint8_t         users;
+	spi_bus_stats_t stats;
+	uint32_t        stats_mutex;   /* guards stats, held only while they are updated or copied */
 } spi_mutex_t;
 
 typedef struct {
@@ -95,6 +121,15 @@ typedef struct {
 	uint8_t   bits_per_word; /* number of bits per word */
 } spi_info_t;
 
+typedef struct {
+	uint8_t*  txBuff;        /* transmit data or NULL to shift out zeros */
+	uint8_t*  rxBuff;        /* receive data or NULL */
+	uint32_t  length;        /* length of tx and rx buffers in bytes */
+	uint16_t  delay;         /* if nonzero, usecs to delay after this transfer */
+	uint8_t   bits;          /* bits per word, 0 for the device default */
+	uint8_t   deselect;      /* (1) to toggle SS after this transfer before the next one */
+} spi_transfer_t;
+
 /*
  * Initialize SPI device
  * @param device spi_info_t struct with all spi params
@@ -150,6 +185,19 @@ int32_t spi_read(spi_info_t* device, uint8_t data[], const uint32_t numBytes);
 */
 int32_t spi_transaction(spi_info_t* device, uint8_t *txBuff, uint8_t * rxBuffer, uint32_t length, uint16_t delay, uint8_t bits, uint8_t deselect);
 
+/*
+ * Perform several full duplex SPI transfers as one message
+ * 
+ * The transfers are issued back to back in a single request to the driver, or in as 
+ * few NOS Engine round trips as the delays and chip select toggles allow.
+ * 
+ * @param spi_info_t struct with all spi params
+ * @param xfers array of transfers to perform in order
+ * @param count number of transfers, at most MAX_SPI_TRANSFERS
+ * @return Returns SPI_SUCCESS or an error code 
+*/
+int32_t spi_multiple_transaction(spi_info_t* device, spi_transfer_t* xfers, uint32_t count);
+
 /*
  * For manual control of the CS line where needed
  * 
@@ -160,6 +208,29 @@ int32_t spi_select_chip(spi_info_t* device);
 
 int32_t spi_unselect_chip(spi_info_t* device);
 
+/*
+ * Set the maximum time a chip select may hold its bus before a warning is raised
+ *
+ * The bus mutex is held from spi_select_chip until spi_unselect_chip, so a long 
+ * hold by a low priority task delays every other device on the bus.
+ *
+ * @param bus the SPI bus number
+ * @param max_hold_us maximum hold time in microseconds, 0 disables the check
+ * @return Returns SPI_SUCCESS or an error code
+*/
+int32_t spi_set_max_hold_time(uint8_t bus, uint32_t max_hold_us);
+
+/*
+ * Get a copy of the bus arbitration statistics
+ *
+ * The statistics have their own lock, so this does not wait for the current bus holder.
+ *
+ * @param bus the SPI bus number
+ * @param stats destination for the current holder and per chip select hold times
+ * @return Returns SPI_SUCCESS, or an error code if no device on the bus is open or the stats lock fails (stats untouched)
+*/
+int32_t spi_get_bus_stats(uint8_t bus, spi_bus_stats_t* stats);
+
 /*
  * Close the SPI device 
  * 
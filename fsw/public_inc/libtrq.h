@@ -52,27 +52,48 @@ ivv-itc@lists.nasa.gov
 #define TRQ_DIR_POSITIVE        1
 #define TRQ_DIR_NEGATIVE        0
 
+#define TRQ_MAX_DEVICES         3
+
+#define TRQ_DUTY_Q16_ONE        65536u  // 100% duty as an unsigned Q16 fraction
+
 /* Torquer info struct */
 typedef struct {
     // User initialized fields
     uint8_t     trq_num;            // torquer number (0, 1, 2)
     uint32_t    timer_period_ns;    // nanoseconds
+    uint32_t    timer_clock_hz;     // AXI timer input clock, enables glitch-free high time updates when set
     // HWLIB managed fields
     int         timerfd; 
     int         direction_pin_fd;
     uint32_t    timer_high_ns;      // nanoseconds 
     bool        positive_direction; // TRUE = Positive direction, FALSE = Negative direction
     bool        enabled;
+    bool        shadow_selected;    // high time load register selected for shadow updates
 } trq_info_t;
 
+/* One torquer's part of a trq_command_set */
+typedef struct {
+    trq_info_t* device;
+    uint32_t    duty_q16;           // Fraction of the period to be high, 0 to TRQ_DUTY_Q16_ONE
+    bool        pos_dir;            // TRUE = Positive direction, FALSE = Negative direction
+} trq_cmd_t;
+
 void trq_dummy(void);
 
 int32_t trq_set_time_high(trq_info_t* device, uint32_t new_time);
 int32_t trq_set_period(trq_info_t* device);
 int32_t trq_set_direction(trq_info_t* device, bool direction);
+int32_t trq_update_pending(trq_info_t* device, bool* pending);
 
 int32_t trq_init(trq_info_t* device); 
 int32_t trq_command(trq_info_t *device, uint8_t percent_high, bool pos_dir);
+int32_t trq_command_ns(trq_info_t *device, uint32_t time_high_ns, bool pos_dir);
+int32_t trq_command_q16(trq_info_t *device, uint32_t duty_q16, bool pos_dir);
+int32_t trq_command_set(trq_cmd_t* cmds, uint8_t count);
+
+/* Duty cycle conversions, integer only */
+int32_t trq_percent_to_ns(trq_info_t *device, uint8_t percent_high, uint32_t *time_high_ns);
+int32_t trq_q16_to_ns(trq_info_t *device, uint32_t duty_q16, uint32_t *time_high_ns);
 void trq_close(trq_info_t* device);
 
 #endif
@@ -0,0 +1,208 @@
+/* Copyright (C) 2009 - 2020 National Aeronautics and Space Administration. All Foreign Rights are Reserved to the U.S. Government.
+
+   This software is provided "as is" without any warranty of any, kind either express, implied, or statutory, including, but not
+   limited to, any warranty that the software will conform to, specifications any implied warranties of merchantability, fitness
+   for a particular purpose, and freedom from infringement, and any warranty that the documentation will conform to the program, or
+   any warranty that the software will be error free.
+
+   In no event shall NASA be liable for any damages, including, but not limited to direct, indirect, special or consequential damages,
+   arising out of, resulting from, or in any way connected with the software or its documentation.  Whether or not based upon warranty,
+   contract, tort or otherwise, and whether or not loss was sustained from, or arose out of the results of, or use of, the software,
+   documentation or services provided hereunder
+
+   ITC Team
+   NASA IV&V
+   ivv-itc@lists.nasa.gov
+*/
+
+#include <string.h>
+#include <time.h>
+
+#include "libi2c.h"
+
+/*
+** The scheduler task is the only writer of a slot. It fills the buffer that is not
+** current, flips current and then bumps seq. A reader samples seq, copies the current
+** buffer and retries if seq moved, which can only happen once the writer has started
+** refilling the buffer being copied.
+*/
+
+static uint64_t i2c_sched_time_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+}
+
+static void i2c_sched_publish(i2c_sched_slot_t* slot, uint8_t back, int32_t status)
+{
+    slot->status = status;
+    if (status == I2C_SUCCESS)
+    {
+        slot->timestamp_ns[back] = i2c_sched_time_ns();
+        __atomic_store_n(&slot->current, back, __ATOMIC_RELEASE);
+    }
+    __atomic_add_fetch(&slot->seq, 1, __ATOMIC_RELEASE);
+}
+
+int32_t i2c_sched_init(i2c_sched_t* sched, i2c_bus_info_t* device, uint16_t timeout)
+{
+    if (device->isOpen != I2C_OPEN)
+    {
+        return I2C_ERROR;
+    }
+
+    memset(sched, 0, sizeof(i2c_sched_t));
+    sched->device = device;
+    sched->timeout = timeout;
+
+    return I2C_SUCCESS;
+}
+
+int32_t i2c_sched_add(i2c_sched_t* sched, uint8_t addr, uint8_t reg, uint16_t len, uint32_t period_ms, uint32_t* slot_id)
+{
+    i2c_sched_slot_t* slot;
+
+    if ((sched->num_slots >= I2C_SCHED_MAX_SLOTS) || (len == 0) || (len > I2C_SCHED_MAX_LEN) || (period_ms == 0))
+    {
+        return I2C_ERROR;
+    }
+
+    slot = &sched->slot[sched->num_slots];
+    memset(slot, 0, sizeof(i2c_sched_slot_t));
+    slot->addr = addr;
+    slot->reg = reg;
+    slot->len = len;
+    slot->period_ms = period_ms;
+    slot->next_ms = i2c_sched_time_ns() / 1000000;
+    slot->status = I2C_ERROR;
+
+    *slot_id = sched->num_slots;
+    sched->num_slots++;
+
+    return I2C_SUCCESS;
+}
+
+int32_t i2c_sched_set_flags(i2c_sched_t* sched, uint32_t slot_id, uint8_t flags)
+{
+    if (slot_id >= sched->num_slots)
+    {
+        return I2C_ERROR;
+    }
+
+    sched->slot[slot_id].flags = flags;
+
+    return I2C_SUCCESS;
+}
+
+int32_t i2c_sched_run(i2c_sched_t* sched)
+{
+    int32_t          status = I2C_SUCCESS;
+    i2c_batch_op_t   ops[I2C_SCHED_MAX_SLOTS];
+    uint32_t         due[I2C_SCHED_MAX_SLOTS];
+    uint32_t         num_due = 0;
+    uint64_t         now_ms = i2c_sched_time_ns() / 1000000;
+    i2c_sched_slot_t* slot;
+    uint8_t          back;
+    uint32_t         i;
+
+    /* Collect the due slots, each reads into its back buffer */
+    for (i = 0; i < sched->num_slots; i++)
+    {
+        slot = &sched->slot[i];
+        if (now_ms < slot->next_ms)
+        {
+            continue;
+        }
+
+        back = slot->current ^ 1;
+        ops[num_due].addr = slot->addr;
+        ops[num_due].txbuf = &slot->reg;
+        ops[num_due].txlen = 1;
+        ops[num_due].rxbuf = slot->data[back];
+        ops[num_due].rxlen = slot->len;
+        due[num_due] = i;
+        num_due++;
+
+        /* Keep the schedule phase unless the slot fell a whole period behind */
+        slot->next_ms += slot->period_ms;
+        if (slot->next_ms <= now_ms)
+        {
+            slot->next_ms = now_ms + slot->period_ms;
+        }
+    }
+
+    if (num_due == 0)
+    {
+        return status;
+    }
+
+    if (i2c_batch_transaction(sched->device, ops, num_due, sched->timeout) == I2C_SUCCESS)
+    {
+        for (i = 0; i < num_due; i++)
+        {
+            slot = &sched->slot[due[i]];
+            i2c_sched_publish(slot, slot->current ^ 1, I2C_SUCCESS);
+        }
+        return status;
+    }
+
+    /*
+    ** Retry one at a time to find the failing slaves. Reads before the failure may have
+    ** completed, so a slot whose register must not be read twice is failed instead.
+    */
+    for (i = 0; i < num_due; i++)
+    {
+        slot = &sched->slot[due[i]];
+        if (((slot->flags & I2C_SCHED_NO_RETRY) == 0) &&
+            (i2c_batch_transaction(sched->device, &ops[i], 1, sched->timeout) == I2C_SUCCESS))
+        {
+            i2c_sched_publish(slot, slot->current ^ 1, I2C_SUCCESS);
+        }
+        else
+        {
+            i2c_sched_publish(slot, slot->current, I2C_ERROR);
+            status = I2C_ERROR;
+        }
+    }
+
+    return status;
+}
+
+int32_t i2c_sched_read(i2c_sched_t* sched, uint32_t slot_id, void* rxbuf, uint16_t rxlen, uint64_t* timestamp_ns)
+{
+    i2c_sched_slot_t* slot;
+    uint32_t          seq;
+    uint8_t           current;
+    uint64_t          timestamp;
+    int32_t           status;
+
+    if ((slot_id >= sched->num_slots) || (rxlen > sched->slot[slot_id].len))
+    {
+        return I2C_ERROR;
+    }
+    slot = &sched->slot[slot_id];
+
+    do
+    {
+        seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        current = __atomic_load_n(&slot->current, __ATOMIC_ACQUIRE);
+        memcpy(rxbuf, slot->data[current], rxlen);
+        timestamp = slot->timestamp_ns[current];
+        status = slot->status;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (seq != __atomic_load_n(&slot->seq, __ATOMIC_RELAXED));
+
+    if (timestamp_ns != NULL)
+    {
+        *timestamp_ns = timestamp;
+    }
+
+    if (timestamp == 0)
+    {
+        return I2C_ERROR;
+    }
+
+    return status;
+}
@@ -0,0 +1,72 @@
+/* Copyright (C) 2009 - 2020 National Aeronautics and Space Administration. All Foreign Rights are Reserved to the U.S. Government.
+
+   This software is provided "as is" without any warranty of any, kind either express, implied, or statutory, including, but not
+   limited to, any warranty that the software will conform to, specifications any implied warranties of merchantability, fitness
+   for a particular purpose, and freedom from infringement, and any warranty that the documentation will conform to the program, or
+   any warranty that the software will be error free.
+
+   In no event shall NASA be liable for any damages, including, but not limited to direct, indirect, special or consequential damages,
+   arising out of, resulting from, or in any way connected with the software or its documentation.  Whether or not based upon warranty,
+   contract, tort or otherwise, and whether or not loss was sustained from, or arose out of the results of, or use of, the software,
+   documentation or services provided hereunder
+
+   ITC Team
+   NASA IV&V
+   ivv-itc@lists.nasa.gov
+*/
+
+#include "libi2c.h"
+
+int32_t i2c_stream_read(i2c_bus_info_t* device, uint8_t addr, uint32_t offset, uint8_t offset_len, void* rxbuf, uint32_t rxlen, uint16_t page_size, uint16_t timeout)
+{
+    i2c_batch_op_t ops[I2C_MAX_MSGS - 1];
+    uint8_t        offset_buf[4];
+    uint8_t*       rx = (uint8_t*) rxbuf;
+    uint32_t       num_ops;
+    uint32_t       chunk;
+    uint8_t        i;
+
+    if ((offset_len == 0) || (offset_len > sizeof(offset_buf)))
+    {
+        return I2C_ERROR;
+    }
+
+    if ((page_size == 0) || (page_size > I2C_MAX_BYTES))
+    {
+        page_size = I2C_MAX_BYTES;
+    }
+
+    while (rxlen > 0)
+    {
+        /* Address the start of this run of pages, most significant byte first */
+        for (i = 0; i < offset_len; i++)
+        {
+            offset_buf[i] = (uint8_t) (offset >> (8 * (offset_len - 1 - i)));
+        }
+
+        /* The first read follows the offset write, the rest continue from the device address pointer */
+        num_ops = 0;
+        while ((rxlen > 0) && (num_ops < (I2C_MAX_MSGS - 1)))
+        {
+            chunk = (rxlen < page_size) ? rxlen : page_size;
+
+            ops[num_ops].addr = addr;
+            ops[num_ops].txbuf = (num_ops == 0) ? offset_buf : NULL;
+            ops[num_ops].txlen = (num_ops == 0) ? offset_len : 0;
+            ops[num_ops].rxbuf = rx;
+            ops[num_ops].rxlen = (uint16_t) chunk;
+            num_ops++;
+
+            rx += chunk;
+            offset += chunk;
+            rxlen -= chunk;
+        }
+
+        if (i2c_batch_transaction(device, ops, num_ops, timeout) != I2C_SUCCESS)
+        {
+            return I2C_ERROR;
+        }
+    }
+
+    return I2C_SUCCESS;
+}
@@ -15,6 +15,8 @@
    ivv-itc@lists.nasa.gov
 */
 
+#include <string.h>
+
 #include "libmem.h"
 
 // ok... dummy usage... just so when the linker creates hwlib.so it does not throw out the libmem.c.o object from libnoslink.a as not used
@@ -22,4 +24,107 @@ void mem_dummy()
 {
     uint8_t tmp;
     devmem_read(0,&tmp, 1);
-}
\ No newline at end of file
+}
+
+/* largest access that is naturally aligned at addr and fits in the remaining length */
+static uint32_t mem_access_width(uintptr_t addr, uint32_t length)
+{
+    uint32_t width = MEM_BURST_MAX_WIDTH;
+
+    while ((width > 1) && (((addr & (width - 1)) != 0) || (length < width)))
+    {
+        width >>= 1;
+    }
+
+    return width;
+}
+
+static int mem_region_contains(const mem_region_t* region, uint32_t offset, uint32_t length)
+{
+    return (region->isOpen == MEM_OPEN) && (offset <= region->length) && (length <= (region->length - offset));
+}
+
+int32_t mem_region_copy_from(const mem_region_t* region, uint32_t offset, void* out, uint32_t length)
+{
+    uint8_t* dst = (uint8_t*) out;
+    uint64_t value64;
+    uint32_t value32;
+    uint16_t value16;
+    uint32_t width;
+
+    if (!mem_region_contains(region, offset, length))
+    {
+        return MEM_ERROR;
+    }
+
+    /* the device side decides the width, the buffer side goes through memcpy so it may be unaligned */
+    while (length > 0)
+    {
+        width = mem_access_width((uintptr_t) (region->addr + offset), length);
+        switch (width)
+        {
+            case 8:
+                value64 = mem_region_read64(region, offset);
+                memcpy(dst, &value64, 8);
+                break;
+            case 4:
+                value32 = mem_region_read32(region, offset);
+                memcpy(dst, &value32, 4);
+                break;
+            case 2:
+                value16 = mem_region_read16(region, offset);
+                memcpy(dst, &value16, 2);
+                break;
+            default:
+                *dst = mem_region_read8(region, offset);
+                break;
+        }
+        dst += width;
+        offset += width;
+        length -= width;
+    }
+
+    return MEM_SUCCESS;
+}
+
+int32_t mem_region_copy_to(const mem_region_t* region, uint32_t offset, const void* in, uint32_t length)
+{
+    const uint8_t* src = (const uint8_t*) in;
+    uint64_t value64;
+    uint32_t value32;
+    uint16_t value16;
+    uint32_t width;
+
+    if (!mem_region_contains(region, offset, length))
+    {
+        return MEM_ERROR;
+    }
+
+    while (length > 0)
+    {
+        width = mem_access_width((uintptr_t) (region->addr + offset), length);
+        switch (width)
+        {
+            case 8:
+                memcpy(&value64, src, 8);
+                mem_region_write64(region, offset, value64);
+                break;
+            case 4:
+                memcpy(&value32, src, 4);
+                mem_region_write32(region, offset, value32);
+                break;
+            case 2:
+                memcpy(&value16, src, 2);
+                mem_region_write16(region, offset, value16);
+                break;
+            default:
+                mem_region_write8(region, offset, *src);
+                break;
+        }
+        src += width;
+        offset += width;
+        length -= width;
+    }
+
+    return MEM_SUCCESS;
+}
@@ -17,9 +17,328 @@
 
 #include "libsocket.h"
 
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
 // ok... dummy usage... just so when the linker creates hwlib.so it does not throw out the libsocket.c.o object from libnoslink.a as not used
 void socket_dummy()
 {
     socket_info_t device;
     socket_create(&device);
-}
\ No newline at end of file
+}
+
+// Accepts a connection on a listening socket into a separate socket_info
+// Unlike socket_accept the server socket keeps listening, so it can stay in an event loop
+//
+// Inputs:
+//      server_info->listening
+//      server_info->sockfd
+//
+// Outputs:
+//      client_info (a connected stream socket with the server's settings)
+int32_t socket_accept_client(socket_info_t* server_info, socket_info_t* client_info)
+{
+    int ret;
+    int flags;
+    struct sockaddr_in client_addr;
+    socklen_t c;
+    int32_t status;
+
+    status = SOCKET_SUCCESS;
+
+    // Only accept connections on a socket that is in a listening state
+    if(server_info->listening==false)
+    {
+        status = SOCKET_ACCEPT_ERR;
+        return status;
+    }
+
+    c = sizeof(struct sockaddr_in);
+    ret = accept(server_info->sockfd, (struct sockaddr *)&client_addr, &c);
+    if (ret == -1)
+    {
+        // Handle non-blocking sockets
+        if( (server_info->block==false) && ((errno==EAGAIN) || (errno==EWOULDBLOCK)) )
+        {
+            status = SOCKET_TRY_AGAIN;
+            return status;
+        }
+        status = SOCKET_ACCEPT_ERR;
+        return status;
+    }
+
+    // The accepted socket does not inherit O_NONBLOCK
+    if(server_info->block==false)
+    {
+        flags = fcntl(ret, F_GETFL, 0);
+        fcntl(ret, F_SETFL, flags | O_NONBLOCK);
+    }
+
+    // Assign values to the client socket_info structure
+    *client_info = *server_info;
+    client_info->sockfd = ret;
+    client_info->created = true;
+    client_info->bound = false;
+    client_info->listening = false;
+    client_info->connected = true;
+
+    return status;
+}
+
+// Event loop
+//
+// Sockets are registered with SOCKET_EVENT_READ, WRITE and/or ACCEPT interest and
+// socket_loop_wait returns the ready ones from a single epoll_wait. Every event is
+// passed to the socket's callback, if it has one, and copied to the events array.
+// Sockets are level triggered, so an unread socket is reported again on the next wait.
+
+static uint32_t socket_loop_epoll_events(uint32_t interest)
+{
+    uint32_t events = 0;
+
+    if(interest & (SOCKET_EVENT_READ | SOCKET_EVENT_ACCEPT))
+    {
+        events |= EPOLLIN | EPOLLRDHUP;
+    }
+    if(interest & SOCKET_EVENT_WRITE)
+    {
+        events |= EPOLLOUT;
+    }
+
+    return events;
+}
+
+static socket_loop_entry_t* socket_loop_find(socket_loop_t* loop, socket_info_t* socket_info)
+{
+    uint32_t i;
+
+    for(i = 0; i < SOCKET_LOOP_MAX_SOCKETS; i++)
+    {
+        if(loop->entry[i].socket_info == socket_info)
+        {
+            return &loop->entry[i];
+        }
+    }
+
+    return NULL;
+}
+
+// Slots released by a callback stay unused until the wait returns, so the rest of
+// the batch cannot deliver events of the removed socket to a new one
+static socket_loop_entry_t* socket_loop_find_free(socket_loop_t* loop)
+{
+    uint32_t i;
+
+    for(i = 0; i < SOCKET_LOOP_MAX_SOCKETS; i++)
+    {
+        if((loop->entry[i].socket_info == NULL) && (!loop->entry[i].released))
+        {
+            return &loop->entry[i];
+        }
+    }
+
+    return NULL;
+}
+
+int32_t socket_loop_init(socket_loop_t* loop)
+{
+    memset(loop, 0, sizeof(socket_loop_t));
+
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if(loop->epfd == -1)
+    {
+        OS_printf("socket_loop_init: epoll_create1 failed, errno = %d\n", errno);
+        return SOCKET_LOOP_ERR;
+    }
+
+    return SOCKET_SUCCESS;
+}
+
+int32_t socket_loop_add(socket_loop_t* loop, socket_info_t* socket_info, uint32_t interest, socket_event_cb_t callback, void* arg)
+{
+    socket_loop_entry_t* entry;
+    struct epoll_event ev;
+
+    if( (socket_info == NULL) || (!socket_info->created) || (socket_loop_find(loop, socket_info) != NULL) )
+    {
+        return SOCKET_LOOP_ERR;
+    }
+
+    entry = socket_loop_find_free(loop);
+    if(entry == NULL)
+    {
+        return SOCKET_LOOP_ERR;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = socket_loop_epoll_events(interest);
+    ev.data.ptr = entry;
+    if(epoll_ctl(loop->epfd, EPOLL_CTL_ADD, socket_info->sockfd, &ev) == -1)
+    {
+        OS_printf("socket_loop_add: epoll_ctl failed for sockfd %d, errno = %d\n", socket_info->sockfd, errno);
+        return SOCKET_LOOP_ERR;
+    }
+
+    entry->socket_info = socket_info;
+    entry->sockfd = socket_info->sockfd;
+    entry->interest = interest;
+    entry->callback = callback;
+    entry->arg = arg;
+    loop->num_sockets++;
+
+    return SOCKET_SUCCESS;
+}
+
+int32_t socket_loop_modify(socket_loop_t* loop, socket_info_t* socket_info, uint32_t interest)
+{
+    socket_loop_entry_t* entry;
+    struct epoll_event ev;
+
+    entry = socket_loop_find(loop, socket_info);
+    if( (socket_info == NULL) || (entry == NULL) )
+    {
+        return SOCKET_LOOP_ERR;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = socket_loop_epoll_events(interest);
+    ev.data.ptr = entry;
+    if(epoll_ctl(loop->epfd, EPOLL_CTL_MOD, entry->sockfd, &ev) == -1)
+    {
+        return SOCKET_LOOP_ERR;
+    }
+    entry->interest = interest;
+
+    return SOCKET_SUCCESS;
+}
+
+// Remove a socket before closing it
+int32_t socket_loop_remove(socket_loop_t* loop, socket_info_t* socket_info)
+{
+    socket_loop_entry_t* entry;
+
+    entry = socket_loop_find(loop, socket_info);
+    if( (socket_info == NULL) || (entry == NULL) )
+    {
+        return SOCKET_LOOP_ERR;
+    }
+
+    // A closed descriptor has already left the epoll set
+    if( (epoll_ctl(loop->epfd, EPOLL_CTL_DEL, entry->sockfd, NULL) == -1) && (errno != EBADF) && (errno != ENOENT) )
+    {
+        return SOCKET_LOOP_ERR;
+    }
+
+    memset(entry, 0, sizeof(socket_loop_entry_t));
+    entry->released = loop->dispatching;
+    loop->num_sockets--;
+
+    return SOCKET_SUCCESS;
+}
+
+// Waits up to timeout_ms (-1 forever, 0 to poll) for any registered socket to become ready
+// events may be NULL when every socket has a callback, otherwise max_events must be at least 1
+int32_t socket_loop_wait(socket_loop_t* loop, socket_event_t* events, uint32_t max_events, int32_t timeout_ms, uint32_t* num_events)
+{
+    struct epoll_event ready[SOCKET_LOOP_MAX_SOCKETS];
+    socket_loop_entry_t* entry;
+    socket_info_t* socket_info;
+    uint32_t flags;
+    uint32_t count = 0;
+    int ret;
+    int i;
+
+    *num_events = 0;
+
+    if( (events != NULL) && (max_events == 0) )
+    {
+        return SOCKET_LOOP_ERR;
+    }
+
+    if( (events == NULL) || (max_events > SOCKET_LOOP_MAX_SOCKETS) )
+    {
+        max_events = SOCKET_LOOP_MAX_SOCKETS;
+    }
+
+    ret = epoll_wait(loop->epfd, ready, (int) max_events, timeout_ms);
+    if(ret == -1)
+    {
+        if(errno == EINTR)
+        {
+            return SOCKET_TRY_AGAIN;
+        }
+        return SOCKET_LOOP_ERR;
+    }
+
+    loop->dispatching = true;
+    for(i = 0; i < ret; i++)
+    {
+        entry = (socket_loop_entry_t*) ready[i].data.ptr;
+
+        // Removed by an earlier callback in this batch
+        if(entry->socket_info == NULL)
+        {
+            continue;
+        }
+
+        flags = 0;
+        if(ready[i].events & EPOLLIN)
+        {
+            flags |= (entry->interest & SOCKET_EVENT_ACCEPT) ? SOCKET_EVENT_ACCEPT : SOCKET_EVENT_READ;
+        }
+        if(ready[i].events & EPOLLOUT)
+        {
+            flags |= SOCKET_EVENT_WRITE;
+        }
+        if(ready[i].events & (EPOLLHUP | EPOLLRDHUP))
+        {
+            flags |= SOCKET_EVENT_HANGUP;
+        }
+        if(ready[i].events & EPOLLERR)
+        {
+            flags |= SOCKET_EVENT_ERROR;
+        }
+
+        socket_info = entry->socket_info;
+        if(events != NULL)
+        {
+            events[count].socket_info = socket_info;
+            events[count].events = flags;
+            events[count].arg = entry->arg;
+        }
+        count++;
+
+        if(entry->callback != NULL)
+        {
+            entry->callback(socket_info, flags, entry->arg);
+        }
+    }
+    loop->dispatching = false;
+
+    // Slots released by callbacks may be reused from now on
+    for(i = 0; i < SOCKET_LOOP_MAX_SOCKETS; i++)
+    {
+        loop->entry[i].released = false;
+    }
+
+    *num_events = count;
+
+    return SOCKET_SUCCESS;
+}
+
+int32_t socket_loop_close(socket_loop_t* loop)
+{
+    if(close(loop->epfd) == -1)
+    {
+        return SOCKET_CLOSE_ERR;
+    }
+    memset(loop, 0, sizeof(socket_loop_t));
+    loop->epfd = -1;
+
+    return SOCKET_SUCCESS;
+}
@@ -22,4 +22,30 @@ void trq_dummy()
 {
     trq_info_t device;
     trq_init(&device);
-}
\ No newline at end of file
+}
+
+/* Percent of the period, truncated like the original floating point conversion */
+int32_t trq_percent_to_ns(trq_info_t *device, uint8_t percent_high, uint32_t *time_high_ns)
+{
+    if (percent_high > 100)
+    {
+        printf("trq_command: Error setting percent high greater than 100! \n");
+        return TRQ_TIME_HIGH_VAL_ERR;
+    }
+
+    *time_high_ns = (uint32_t) (((uint64_t) device->timer_period_ns * percent_high) / 100);
+    return TRQ_SUCCESS;
+}
+
+/* Q16 fraction of the period, rounded to the nearest nanosecond */
+int32_t trq_q16_to_ns(trq_info_t *device, uint32_t duty_q16, uint32_t *time_high_ns)
+{
+    if (duty_q16 > TRQ_DUTY_Q16_ONE)
+    {
+        printf("trq_command: Error setting duty 0x%X greater than 1.0! \n", duty_q16);
+        return TRQ_TIME_HIGH_VAL_ERR;
+    }
+
+    *time_high_ns = (uint32_t) ((((uint64_t) device->timer_period_ns * duty_q16) + (TRQ_DUTY_Q16_ONE / 2)) >> 16);
+    return TRQ_SUCCESS;
+}
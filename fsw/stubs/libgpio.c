@@ -36,3 +36,38 @@ int32_t gpio_close(gpio_info_t* device)
 {
     return GPIO_SUCCESS;
 }
+
+int32_t gpio_group_init(gpio_group_t* group)
+{
+    return GPIO_SUCCESS;
+}
+
+int32_t gpio_group_read(gpio_group_t* group, uint32_t* values)
+{
+    return GPIO_SUCCESS;
+}
+
+int32_t gpio_group_write(gpio_group_t* group, uint32_t values, uint32_t mask)
+{
+    return GPIO_SUCCESS;
+}
+
+int32_t gpio_group_close(gpio_group_t* group)
+{
+    return GPIO_SUCCESS;
+}
+
+int32_t gpio_wait_event(gpio_info_t* device, gpio_event_t* event, int32_t timeout_ms)
+{
+    return GPIO_SUCCESS;
+}
+
+int32_t gpio_poll_events(gpio_info_t** devices, uint32_t count, int32_t timeout_ms)
+{
+    return GPIO_SUCCESS;
+}
+
+int32_t gpio_event_fd(gpio_info_t* device)
+{
+    return GPIO_ERROR;
+}
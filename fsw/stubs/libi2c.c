@@ -29,17 +29,22 @@ int32_t i2c_master_init(i2c_bus_info_t* device)
     return I2C_SUCCESS;
 }
 
-int32_t i2c_master_transaction(i2c_bus_info_t* device, uint8_t addr, void * txbuf, uint8_t txlen, void * rxbuf, uint8_t rxlen, uint16_t timeout)
+int32_t i2c_master_config(i2c_bus_info_t* device, uint8_t retries, uint8_t recover, uint32_t scl_pin, uint32_t sda_pin)
 {
     return I2C_SUCCESS;
 }
 
-int32_t i2c_read_transaction(i2c_bus_info_t* device, uint8_t addr, void * rxbuf, uint8_t rxlen, uint8_t timeout)
+int32_t i2c_master_transaction(i2c_bus_info_t* device, uint8_t addr, void * txbuf, uint16_t txlen, void * rxbuf, uint16_t rxlen, uint16_t timeout)
 {
     return I2C_SUCCESS;
 }
 
-int32_t i2c_write_transaction(i2c_bus_info_t* device, uint8_t addr, void * txbuf, uint8_t txlen, uint8_t timeout)
+int32_t i2c_read_transaction(i2c_bus_info_t* device, uint8_t addr, void * rxbuf, uint16_t rxlen, uint16_t timeout)
+{
+    return I2C_SUCCESS;
+}
+
+int32_t i2c_write_transaction(i2c_bus_info_t* device, uint8_t addr, void * txbuf, uint16_t txlen, uint16_t timeout)
 {
     return I2C_SUCCESS;
 }
@@ -48,3 +53,38 @@ int32_t i2c_multiple_transaction(i2c_bus_info_t* device, uint8_t addr, struct i2
 {
     return I2C_SUCCESS;
 }
+
+int32_t i2c_batch_transaction(i2c_bus_info_t* device, i2c_batch_op_t* ops, uint32_t count, uint16_t timeout)
+{
+    return I2C_SUCCESS;
+}
+
+int32_t i2c_bus_recover(i2c_bus_info_t* device)
+{
+    return I2C_SUCCESS;
+}
+
+int32_t smbus_read_byte_data(i2c_bus_info_t* device, uint8_t addr, uint8_t cmd, uint8_t* value, uint16_t timeout)
+{
+    return I2C_SUCCESS;
+}
+
+int32_t smbus_write_byte_data(i2c_bus_info_t* device, uint8_t addr, uint8_t cmd, uint8_t value, uint16_t timeout)
+{
+    return I2C_SUCCESS;
+}
+
+int32_t smbus_read_word_data(i2c_bus_info_t* device, uint8_t addr, uint8_t cmd, uint16_t* value, uint16_t timeout)
+{
+    return I2C_SUCCESS;
+}
+
+int32_t smbus_write_word_data(i2c_bus_info_t* device, uint8_t addr, uint8_t cmd, uint16_t value, uint16_t timeout)
+{
+    return I2C_SUCCESS;
+}
+
+int32_t smbus_block_read(i2c_bus_info_t* device, uint8_t addr, uint8_t cmd, uint8_t* data, uint8_t* len, uint16_t timeout)
+{
+    return I2C_SUCCESS;
+}
@@ -81,3 +81,26 @@ int32_t socket_close(socket_info_t* socket_info)
 {
     return SOCKET_SUCCESS;
 }
+
+int32_t socket_addr_resolve(socket_addr_t* addr, const char* host, int port_num)
+{
+    return SOCKET_SUCCESS;
+}
+
+int32_t socket_send_to(socket_info_t* socket_info, uint8_t* buffer, size_t buflen, size_t* bytes_sent, const socket_addr_t* addr)
+{
+    *bytes_sent = buflen;
+    return SOCKET_SUCCESS;
+}
+
+int32_t socket_send_batch(socket_info_t* socket_info, socket_datagram_t* datagrams, uint32_t count, uint32_t* num_sent)
+{
+    *num_sent = count;
+    return SOCKET_SUCCESS;
+}
+
+int32_t socket_recv_batch(socket_info_t* socket_info, socket_datagram_t* datagrams, uint32_t count, uint32_t* num_recvd)
+{
+    *num_recvd = 0;
+    return SOCKET_SUCCESS;
+}
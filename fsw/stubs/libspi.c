@@ -49,11 +49,26 @@ int32_t spi_transaction(spi_info_t* device, uint8_t *txBuff, uint8_t * rxBuffer,
   return SPI_SUCCESS;
 }
 
+int32_t spi_multiple_transaction(spi_info_t* device, spi_transfer_t* xfers, uint32_t count)
+{
+  return SPI_SUCCESS;
+}
+
 int32_t spi_select_chip(spi_info_t* device)
 {
   return SPI_SUCCESS;
 }
 
+int32_t spi_set_max_hold_time(uint8_t bus, uint32_t max_hold_us)
+{
+  return SPI_SUCCESS;
+}
+
+int32_t spi_get_bus_stats(uint8_t bus, spi_bus_stats_t* stats)
+{
+  return SPI_SUCCESS;
+}
+
 int32_t spi_close_device(spi_info_t* device)
 {
   return SPI_SUCCESS;
@@ -70,6 +70,22 @@ int32_t trq_set_direction(trq_info_t* device, bool direction)
     return TRQ_SUCCESS;
 }
 
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ * trq_update_pending(): Check whether a glitch-free high time update is still waiting for the period boundary.
+ *
+ * Inputs:              trq_info_t *device      -   TRQ device info structure 
+ *
+ * Outputs:             bool *pending           -   true while the previous update has not been applied
+ *                      returns int32_t         -   TRQ_ERROR on failure, TRQ_SUCCESS on success
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+int32_t trq_update_pending(trq_info_t* device, bool* pending)
+{
+    *pending = false;
+    return TRQ_SUCCESS;
+}
+
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  *
  * trq_init():          Opens a TRQ device and initializes it. This function can also be
@@ -103,6 +119,53 @@ int32_t trq_command(trq_info_t *device, uint8_t percent_high, bool pos_dir)
     return TRQ_SUCCESS;
 }
 
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ * trq_command_ns():    Change TQR time high or direction.
+ *
+ * Inputs:              trq_info_t* device      -   TQR device info structure to modify
+ *                      uint32_t time_high_ns   -   Time high per period in nanoseconds (0 to timer_period_ns)
+ *                      bool pos_dir            -   Direction - True for positive, False for negative
+ *
+ * Outputs:             returns int32_t         -   TRQ_ERROR_* type on failure, TRQ_SUCCESS on success
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+int32_t trq_command_ns(trq_info_t *device, uint32_t time_high_ns, bool pos_dir)
+{
+    return TRQ_SUCCESS;
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ * trq_command_q16():   Change TQR time high or direction with a Q16 duty cycle.
+ *
+ * Inputs:              trq_info_t* device      -   TQR device info structure to modify
+ *                      uint32_t duty_q16       -   Fraction of the period to be high (0 to TRQ_DUTY_Q16_ONE)
+ *                      bool pos_dir            -   Direction - True for positive, False for negative
+ *
+ * Outputs:             returns int32_t         -   TRQ_ERROR_* type on failure, TRQ_SUCCESS on success
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+int32_t trq_command_q16(trq_info_t *device, uint32_t duty_q16, bool pos_dir)
+{
+    return TRQ_SUCCESS;
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ * trq_command_set():   Command several TRQs together.
+ *
+ * Inputs:              trq_cmd_t* cmds         -   Commands, one per torquer
+ *                      uint8_t count           -   Number of commands (up to TRQ_MAX_DEVICES)
+ *
+ * Outputs:             returns int32_t         -   TRQ_ERROR_* type on failure, TRQ_SUCCESS on success
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+int32_t trq_command_set(trq_cmd_t* cmds, uint8_t count)
+{
+    return TRQ_SUCCESS;
+}
+
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * 
  *
  * trq_close():         Disables and closes an active TRQ device. 
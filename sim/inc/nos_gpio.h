@@ -0,0 +1,98 @@
+/* Copyright (C) 2009 - 2016 National Aeronautics and Space Administration. All Foreign Rights are Reserved to the U.S. Government.
+
+This software is provided "as is" without any warranty of any, kind either express, implied, or statutory, including, but not
+limited to, any warranty that the software will conform to, specifications any implied warranties of merchantability, fitness
+for a particular purpose, and freedom from infringement, and any warranty that the documentation will conform to the program, or
+any warranty that the software will be error free.
+
+In no event shall NASA be liable for any damages, including, but not limited to direct, indirect, special or consequential damages,
+arising out of, resulting from, or in any way connected with the software or its documentation.  Whether or not based upon warranty,
+contract, tort or otherwise, and whether or not loss was sustained from, or arose out of the results of, or use of, the software,
+documentation or services provided hereunder
+
+ITC Team
+NASA IV&V
+ivv-itc@lists.nasa.gov
+*/
+
+#ifndef _NOS_GPIO_SHM_
+#define _NOS_GPIO_SHM_
+
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "nos_link.h"
+
+/*
+** Simulated GPIO pins shared between flight software and simulators.
+** Pin n is bit (n % 32) of word (n / 32). Writers change the value bitmap atomically,
+** record each pin that changed with nos_gpio_shm_record, then increment seq and wake
+** every futex waiter on it, so one word signals all pins.
+** Every pin keeps a ring of its last NOS_GPIO_PIN_EVENTS edges. Waiters consume the ring
+** by event number, so a pulse shorter than their wakeup latency is still seen as two edges.
+*/
+#define NOS_GPIO_SHM_NAME   "/hwlib_gpio"
+#define NOS_GPIO_WORDS      ((NUM_GPIO_DEVICES + 31) / 32)
+#define NOS_GPIO_PIN_EVENTS 16                 /* power of two */
+
+typedef struct {
+    uint32_t number;                       /* event number + 1 once written, 0 while being written */
+    uint32_t edge;                         /* 1 rising, 2 falling */
+    uint64_t timestamp_ns;                 /* CLOCK_MONOTONIC time of the change */
+} nos_gpio_event_t;
+
+typedef struct {
+    uint32_t seq;                          /* change counter and futex word */
+    uint32_t value[NOS_GPIO_WORDS];        /* pin levels */
+    uint32_t direction[NOS_GPIO_WORDS];    /* 1 for output */
+    uint32_t events[NUM_GPIO_DEVICES];     /* edges recorded on each pin */
+    nos_gpio_event_t event[NUM_GPIO_DEVICES][NOS_GPIO_PIN_EVENTS]; /* edge n of a pin is event[pin][n % NOS_GPIO_PIN_EVENTS] */
+} nos_gpio_shm_t;
+
+/* map the shared pin table, creating it zeroed if this is the first user */
+static inline nos_gpio_shm_t* nos_gpio_shm_map(void)
+{
+    nos_gpio_shm_t* shm;
+    int fd;
+
+    fd = shm_open(NOS_GPIO_SHM_NAME, O_RDWR | O_CREAT, 0666);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    if (ftruncate(fd, sizeof(nos_gpio_shm_t)) < 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    shm = (nos_gpio_shm_t*) mmap(NULL, sizeof(nos_gpio_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    return (shm == MAP_FAILED) ? NULL : shm;
+}
+
+/* record an edge on pin, call after the value change and before bumping seq */
+static inline void nos_gpio_shm_record(nos_gpio_shm_t* shm, uint32_t pin, uint32_t edge)
+{
+    nos_gpio_event_t* event;
+    struct timespec ts;
+    uint32_t n;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    n = __atomic_fetch_add(&shm->events[pin], 1, __ATOMIC_ACQ_REL);
+    event = &shm->event[pin][n % NOS_GPIO_PIN_EVENTS];
+
+    /* readers check number before and after copying, so a slot being rewritten is never taken */
+    __atomic_store_n(&event->number, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&event->edge, edge, __ATOMIC_RELAXED);
+    __atomic_store_n(&event->timestamp_ns, ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec, __ATOMIC_RELAXED);
+    __atomic_store_n(&event->number, n + 1, __ATOMIC_RELEASE);
+}
+
+#endif
@@ -18,6 +18,8 @@ ivv-itc@lists.nasa.gov
 #ifndef _NOS_ENGINE_LINK_
 #define _NOS_ENGINE_LINK_
 
+#include <stdint.h>
+
 /* nos */
 #include <Client/CInterface.h>
 
@@ -26,6 +28,7 @@ ivv-itc@lists.nasa.gov
 #define NUM_CAN_DEVICES  30
 #define NUM_SPI_DEVICES  30
 #define NUM_GPIO_DEVICES 30
+#define NUM_MEM_REGIONS  32
 
 #ifdef __cplusplus
 extern "C" {
@@ -37,6 +40,19 @@ typedef struct {
     const char* bus;
 } nos_connection_t;
 
+/* simulated physical memory region, backed by a POSIX shared memory object */
+typedef struct {
+    const char* name;
+    uint32_t    base;
+    uint32_t    length;
+} nos_mem_region_t;
+
+/* udp endpoint of a simulator outside of nos engine, host is resolved at first use */
+typedef struct {
+    const char* host;
+    uint16_t    port;
+} nos_udp_endpoint_t;
+
 /* nos usart connection table */
 extern nos_connection_t nos_usart_connection[NUM_USARTS];
 
@@ -49,6 +65,15 @@ extern nos_connection_t nos_can_connection[NUM_CAN_DEVICES];
 /* nos spi connection table */
 extern nos_connection_t nos_spi_connection[NUM_SPI_DEVICES];
 
+/* nos memory map, unused entries have length 0 */
+extern nos_mem_region_t nos_mem_map[NUM_MEM_REGIONS];
+
+/* add and map a nos memory map entry at runtime, returns its index or -1 */
+int32_t nos_add_mem_region(const char* name, uint32_t base, uint32_t length);
+
+/* mtb sim torquer command endpoint */
+extern nos_udp_endpoint_t nos_trq_endpoint;
+
 /* common transport hub */
 extern NE_TransportHub *hub;
 
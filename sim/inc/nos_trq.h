@@ -0,0 +1,51 @@
+/* Copyright (C) 2009 - 2016 National Aeronautics and Space Administration. All Foreign Rights are Reserved to the U.S. Government.
+
+This software is provided "as is" without any warranty of any, kind either express, implied, or statutory, including, but not
+limited to, any warranty that the software will conform to, specifications any implied warranties of merchantability, fitness
+for a particular purpose, and freedom from infringement, and any warranty that the documentation will conform to the program, or
+any warranty that the software will be error free.
+
+In no event shall NASA be liable for any damages, including, but not limited to direct, indirect, special or consequential damages,
+arising out of, resulting from, or in any way connected with the software or its documentation.  Whether or not based upon warranty,
+contract, tort or otherwise, and whether or not loss was sustained from, or arose out of the results of, or use of, the software,
+documentation or services provided hereunder
+
+ITC Team
+NASA IV&V
+ivv-itc@lists.nasa.gov
+*/
+
+#ifndef _NOS_TRQ_PACKET_
+#define _NOS_TRQ_PACKET_
+
+#include <stdint.h>
+
+/*
+** Binary torquer command datagram sent to the MTB sim, all fields in network byte order.
+** A packet holds count axes and is applied on one sim tick. seq increments per packet so the
+** sim can drop stale or reordered datagrams; timestamp_ns is CLOCK_MONOTONIC at send time.
+*/
+#define NOS_TRQ_MAGIC       0x54525131  /* "TRQ1" */
+#define NOS_TRQ_MAX_AXES    3
+
+typedef struct __attribute__((packed)) {
+    uint8_t  trq_num;
+    uint8_t  positive_direction;    /* 1 for positive */
+    uint16_t reserved;
+    uint32_t time_high_ns;
+    uint32_t period_ns;
+} nos_trq_axis_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t seq;
+    uint64_t timestamp_ns;
+    uint8_t  count;
+    uint8_t  reserved[3];
+    nos_trq_axis_t axis[NOS_TRQ_MAX_AXES];
+} nos_trq_packet_t;
+
+/* bytes on the wire for a packet of count axes */
+#define NOS_TRQ_PACKET_SIZE(count)  (sizeof(nos_trq_packet_t) - ((NOS_TRQ_MAX_AXES - (count)) * sizeof(nos_trq_axis_t)))
+
+#endif
@@ -0,0 +1,65 @@
+/* Copyright (C) 2009 - 2016 National Aeronautics and Space Administration. All Foreign Rights are Reserved to the U.S. Government.
+
+This software is provided "as is" without any warranty of any, kind either express, implied, or statutory, including, but not
+limited to, any warranty that the software will conform to, specifications any implied warranties of merchantability, fitness
+for a particular purpose, and freedom from infringement, and any warranty that the documentation will conform to the program, or
+any warranty that the software will be error free.
+
+In no event shall NASA be liable for any damages, including, but not limited to direct, indirect, special or consequential damages,
+arising out of, resulting from, or in any way connected with the software or its documentation.  Whether or not based upon warranty,
+contract, tort or otherwise, and whether or not loss was sustained from, or arose out of the results of, or use of, the software,
+documentation or services provided hereunder
+
+ITC Team
+NASA IV&V
+ivv-itc@lists.nasa.gov
+*/
+
+#ifndef _NOS_UIO_SHM_
+#define _NOS_UIO_SHM_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/*
+** Simulated UIO interrupt, one shared memory object per /dev/uioN.
+** The simulator raises an interrupt by incrementing count and waking futex waiters on it;
+** flight software unmasks it by setting enabled, as a write of 1 to the UIO fd would.
+*/
+#define NOS_UIO_SHM_NAME    "/hwlib_uio%u"
+
+typedef struct {
+    uint32_t count;         /* interrupt count and futex word */
+    uint32_t enabled;       /* set when flight software unmasks the interrupt */
+} nos_uio_shm_t;
+
+/* map the shared state of uio N, creating it zeroed if this is the first user */
+static inline nos_uio_shm_t* nos_uio_shm_map(uint32_t uio)
+{
+    nos_uio_shm_t* shm;
+    char name[32];
+    int fd;
+
+    snprintf(name, sizeof(name), NOS_UIO_SHM_NAME, uio);
+    fd = shm_open(name, O_RDWR | O_CREAT, 0666);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    if (ftruncate(fd, sizeof(nos_uio_shm_t)) < 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    shm = (nos_uio_shm_t*) mmap(NULL, sizeof(nos_uio_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    return (shm == MAP_FAILED) ? NULL : shm;
+}
+
+#endif
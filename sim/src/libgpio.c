@@ -17,116 +17,439 @@ ivv-itc@lists.nasa.gov
 
 //#include <cfe_psp.h>
 #include "libgpio.h"
-#include <sys/stat.h>
+#include "nos_gpio.h"
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* shared pin table, mapped by nos_init_link */
+static nos_gpio_shm_t *gpio_shm = NULL;
+
+/* init nos gpio link */
+void nos_init_gpio_link(void)
+{
+    if (gpio_shm == NULL)
+    {
+        gpio_shm = nos_gpio_shm_map();
+        if (gpio_shm == NULL)
+        {
+            OS_printf("nos gpio: unable to map shared memory %s\n", NOS_GPIO_SHM_NAME);
+        }
+    }
+}
+
+/* destroy nos gpio link */
+void nos_destroy_gpio_link(void)
+{
+    if (gpio_shm != NULL)
+    {
+        munmap(gpio_shm, sizeof(nos_gpio_shm_t));
+        gpio_shm = NULL;
+    }
+}
+
+static uint64_t nos_gpio_time_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000) + ((uint64_t) ts.tv_nsec / 1000000);
+}
+
+static uint8_t nos_gpio_get(uint32_t pin)
+{
+    return (__atomic_load_n(&gpio_shm->value[pin / 32], __ATOMIC_ACQUIRE) >> (pin % 32)) & 1;
+}
+
+/* returns 1 if the pin level changed, the edge is recorded in the pin's event ring */
+static int nos_gpio_set(uint32_t pin, uint8_t value)
+{
+    uint32_t bit = 1UL << (pin % 32);
+    uint32_t old;
+
+    if (value)
+    {
+        old = __atomic_fetch_or(&gpio_shm->value[pin / 32], bit, __ATOMIC_ACQ_REL);
+    }
+    else
+    {
+        old = __atomic_fetch_and(&gpio_shm->value[pin / 32], ~bit, __ATOMIC_ACQ_REL);
+    }
+
+    if (((old & bit) != 0) == (value != 0))
+    {
+        return 0;
+    }
+
+    nos_gpio_shm_record(gpio_shm, pin, value ? GPIO_EDGE_RISING : GPIO_EDGE_FALLING);
+    return 1;
+}
+
+/* record an edge for every pin that differs between two values of table word `word` */
+static void nos_gpio_record_word(uint32_t word, uint32_t old, uint32_t new_value)
+{
+    uint32_t changed = old ^ new_value;
+    uint32_t bit;
+
+    for (bit = 0; (bit < 32) && ((word * 32 + bit) < NUM_GPIO_DEVICES); bit++)
+    {
+        if (changed & (1UL << bit))
+        {
+            nos_gpio_shm_record(gpio_shm, word * 32 + bit, ((new_value >> bit) & 1) ? GPIO_EDGE_RISING : GPIO_EDGE_FALLING);
+        }
+    }
+}
+
+/* publish a change to every process waiting on the table */
+static void nos_gpio_notify(void)
+{
+    __atomic_add_fetch(&gpio_shm->seq, 1, __ATOMIC_RELEASE);
+    syscall(SYS_futex, &gpio_shm->seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+/* sleep until seq moves away from `seq` or the deadline passes, returns 0 on timeout */
+static int nos_gpio_wait(uint32_t seq, int32_t timeout_ms, uint64_t deadline)
+{
+    struct timespec ts;
+    uint64_t now;
+
+    if (timeout_ms < 0)
+    {
+        syscall(SYS_futex, &gpio_shm->seq, FUTEX_WAIT, seq, NULL, NULL, 0);
+        return 1;
+    }
+
+    now = nos_gpio_time_ms();
+    if (now >= deadline)
+    {
+        return 0;
+    }
+    ts.tv_sec = (deadline - now) / 1000;
+    ts.tv_nsec = ((deadline - now) % 1000) * 1000000;
+    syscall(SYS_futex, &gpio_shm->seq, FUTEX_WAIT, seq, &ts, NULL, 0);
+    return 1;
+}
+
 int32_t gpio_init(gpio_info_t* device) 
 {    
-    char buffer[128];
-    int  write_size;
-    int  fd;
+    uint32_t bit = 1UL << (device->pin % 32);
 
-    if (device->pin > 30-1) {
-        printf("Please provide a pin # from 0 to %d\n", 30-1);
+    if (device->pin > NUM_GPIO_DEVICES-1) {
+        printf("Please provide a pin # from 0 to %d\n", NUM_GPIO_DEVICES-1);
+        return GPIO_ERROR;
     }
-    // Using a /tmp/ directory to avoid permission issues
-    mkdir("/tmp/gpio-fake/", 0777);
-    snprintf(buffer, 128, "/tmp/gpio-fake/gpio%d/", device->pin);
-    mkdir(buffer, 0777);
-    snprintf(buffer, 128, "/tmp/gpio-fake/gpio%d/direction", device->pin);
 
-    // Set direction
-    fd = open(buffer, O_WRONLY | O_CREAT, 0777);
-    if (fd < 0) 
+    if (gpio_shm == NULL)
     {
         return GPIO_FD_OPEN_ERR;
     }
 
+    // Set direction, outputs start low
     if (device->direction == GPIO_INPUT)
     {
-        snprintf(buffer, 128, "IN");
-        write_size = 2;
-    } else {
-        snprintf(buffer, 128, "OUT");
-        write_size = 3;
+        __atomic_fetch_and(&gpio_shm->direction[device->pin / 32], ~bit, __ATOMIC_ACQ_REL);
+    }
+    else
+    {
+        __atomic_fetch_or(&gpio_shm->direction[device->pin / 32], bit, __ATOMIC_ACQ_REL);
+        if (nos_gpio_set(device->pin, 0))
+        {
+            nos_gpio_notify();
+        }
     }
-    write(fd, buffer, write_size);
-    close(fd);
 
-    //snprintf(buffer, 128, "/tmp/gpio-fake/gpio%d/value", device->pin);
-    //fd = open(buffer, O_WRONLY | O_CREAT);
     // Set open
+    device->handle = device->pin;
     device->isOpen = GPIO_OPEN;
-    gpio_write(device, 0x00);
+    device->seqno = __atomic_load_n(&gpio_shm->events[device->pin], __ATOMIC_ACQUIRE);
     return GPIO_SUCCESS;
 }
 
 int32_t gpio_read(gpio_info_t* device, uint8_t* value)
 {
-    char buffer[128];
-    int fd;
+    if (device->isOpen != GPIO_OPEN) 
+    {
+        return GPIO_READ_ERR;
+    }
 
-    snprintf(buffer, 128, "/tmp/gpio-fake/gpio%d/value", device->pin);
-    fd = open(buffer, O_RDONLY | O_CREAT, 0777);
-    if (fd < 0) 
+    *value = nos_gpio_get(device->pin);
+    return GPIO_SUCCESS;
+}
+
+int32_t gpio_write(gpio_info_t* device, uint8_t value)
+{
+    if (device->isOpen != GPIO_OPEN) 
     {
-         return GPIO_FD_OPEN_ERR;
+        return GPIO_WRITE_ERR;
     }
-    if (read(fd, value, 3) < 0) 
+
+    if (nos_gpio_set(device->pin, value == 1))
     {
-        return GPIO_READ_ERR;
+        nos_gpio_notify();
     }
-    close(fd);
-    if (*value == '1') {
-        *value = 0x01;
-    } else {
-        *value = 0x00;
+    return GPIO_SUCCESS;
+}
+
+int32_t gpio_close(gpio_info_t* device)
+{
+    if (device->isOpen == GPIO_OPEN)
+    {
+        device->isOpen = GPIO_CLOSED;
     }
     return GPIO_SUCCESS;
 }
 
-int32_t gpio_write(gpio_info_t* device, uint8_t value)
+/*
+** Take the next edge on the device's pin from the shared event ring.
+** seqno is the number of events this handle has consumed on the pin.
+*/
+static int nos_gpio_check_edge(gpio_info_t* device, gpio_event_t* event)
 {
-    char buffer[128];
-    char charVal;
-    int fd;
+    nos_gpio_event_t* slot;
+    uint64_t timestamp_ns;
+    uint32_t head;
+    uint32_t number;
+    uint32_t edge;
 
-    if (value == 1) 
+    if ((device->edge == GPIO_EDGE_NONE) || (device->isOpen != GPIO_OPEN))
     {
-        charVal = '1';
+        return 0;
     }
-    else 
+
+    for (;;)
     {
-        charVal = '0';
+        head = __atomic_load_n(&gpio_shm->events[device->pin], __ATOMIC_ACQUIRE);
+        if (device->seqno == head)
+        {
+            return 0;
+        }
+
+        /* the ring only keeps the newest events, the older ones are lost */
+        if ((head - device->seqno) > NOS_GPIO_PIN_EVENTS)
+        {
+            device->seqno = head - NOS_GPIO_PIN_EVENTS;
+        }
+
+        slot = &gpio_shm->event[device->pin][device->seqno % NOS_GPIO_PIN_EVENTS];
+        number = __atomic_load_n(&slot->number, __ATOMIC_ACQUIRE);
+        if (number != device->seqno + 1)
+        {
+            if ((number != 0) && ((int32_t) (number - (device->seqno + 1)) > 0))
+            {
+                /* already overwritten by a later event */
+                device->seqno++;
+                continue;
+            }
+
+            /* still being written, its writer wakes us when done */
+            return 0;
+        }
+
+        edge = __atomic_load_n(&slot->edge, __ATOMIC_RELAXED);
+        timestamp_ns = __atomic_load_n(&slot->timestamp_ns, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        device->seqno++;
+        if (__atomic_load_n(&slot->number, __ATOMIC_RELAXED) != number)
+        {
+            /* overwritten while copying */
+            continue;
+        }
+
+        if (device->edge & edge)
+        {
+            event->timestamp_ns = timestamp_ns;
+            event->seqno = number;
+            event->pin = device->pin;
+            event->edge = (uint8_t) edge;
+            return 1;
+        }
     }
+}
+
+int32_t gpio_event_fd(gpio_info_t* device)
+{
+    /* no pollable fd in the simulation, waiters block on the table futex */
+    return GPIO_ERROR;
+}
 
-    snprintf(buffer, 128, "/tmp/gpio-fake/gpio%d/value", device->pin);
-    fd = open(buffer, O_WRONLY | O_CREAT, 0777);
-    if (fd < 0) 
+int32_t gpio_wait_event(gpio_info_t* device, gpio_event_t* event, int32_t timeout_ms)
+{
+    uint64_t deadline = nos_gpio_time_ms() + ((timeout_ms > 0) ? timeout_ms : 0);
+    uint32_t seq;
+
+    if ((device->isOpen != GPIO_OPEN) || (device->edge == GPIO_EDGE_NONE))
     {
-         return GPIO_FD_OPEN_ERR;
+        return GPIO_ERROR;
     }
 
-    if (write(fd, &charVal, 1) != 1) 
+    for (;;)
     {
-        return GPIO_WRITE_ERR;
+        /* sample seq first so a change after the check wakes the wait immediately */
+        seq = __atomic_load_n(&gpio_shm->seq, __ATOMIC_ACQUIRE);
+        if (nos_gpio_check_edge(device, event))
+        {
+            return GPIO_SUCCESS;
+        }
+        if (!nos_gpio_wait(seq, timeout_ms, deadline))
+        {
+            return GPIO_TIMEOUT_ERR;
+        }
     }
+}
+
+int32_t gpio_poll_events(gpio_info_t** devices, uint32_t count, int32_t timeout_ms)
+{
+    uint64_t deadline = nos_gpio_time_ms() + ((timeout_ms > 0) ? timeout_ms : 0);
+    gpio_event_t event;
+    int32_t dispatched = 0;
+    uint32_t seq;
+    uint32_t i;
 
-    close(fd);
+    if ((count == 0) || (count > GPIO_POLL_MAX_DEVICES) || (gpio_shm == NULL))
+    {
+        return GPIO_ERROR;
+    }
+
+    for (;;)
+    {
+        seq = __atomic_load_n(&gpio_shm->seq, __ATOMIC_ACQUIRE);
+        for (i = 0; i < count; i++)
+        {
+            while (nos_gpio_check_edge(devices[i], &event))
+            {
+                if (devices[i]->callback != NULL)
+                {
+                    devices[i]->callback(&event, devices[i]->callback_arg);
+                }
+                dispatched++;
+            }
+        }
+
+        if ((dispatched > 0) || !nos_gpio_wait(seq, timeout_ms, deadline))
+        {
+            break;
+        }
+    }
+
+    return dispatched;
+}
+
+int32_t gpio_group_init(gpio_group_t* group)
+{
+    gpio_info_t device;
+    int32_t status;
+    uint8_t i;
+
+    if ((group->num_pins == 0) || (group->num_pins > GPIO_GROUP_MAX_PINS))
+    {
+        return GPIO_ERROR;
+    }
+
+    memset(&device, 0, sizeof(device));
+    device.direction = group->direction;
+    for (i = 0; i < group->num_pins; i++)
+    {
+        device.pin = group->pins[i];
+        status = gpio_init(&device);
+        if (status != GPIO_SUCCESS)
+        {
+            return status;
+        }
+    }
+
+    group->isOpen = GPIO_OPEN;
     return GPIO_SUCCESS;
 }
 
-int32_t gpio_close(gpio_info_t* device)
+int32_t gpio_group_read(gpio_group_t* group, uint32_t* values)
 {
+    uint32_t words[NOS_GPIO_WORDS];
+    uint8_t i;
 
-    
-    if (device->isOpen == GPIO_OPEN)
+    if (group->isOpen != GPIO_OPEN)
     {
-        device->isOpen = GPIO_CLOSED;
+        return GPIO_READ_ERR;
+    }
+
+    for (i = 0; i < NOS_GPIO_WORDS; i++)
+    {
+        words[i] = __atomic_load_n(&gpio_shm->value[i], __ATOMIC_ACQUIRE);
+    }
+
+    *values = 0;
+    for (i = 0; i < group->num_pins; i++)
+    {
+        *values |= ((words[group->pins[i] / 32] >> (group->pins[i] % 32)) & 1UL) << i;
+    }
+
+    return GPIO_SUCCESS;
+}
+
+int32_t gpio_group_write(gpio_group_t* group, uint32_t values, uint32_t mask)
+{
+    uint32_t set[NOS_GPIO_WORDS] = {0};
+    uint32_t clear[NOS_GPIO_WORDS] = {0};
+    uint32_t old;
+    uint32_t new_value;
+    int changed = 0;
+    uint8_t i;
+
+    if (group->isOpen != GPIO_OPEN)
+    {
+        return GPIO_WRITE_ERR;
+    }
+
+    for (i = 0; i < group->num_pins; i++)
+    {
+        if (mask & (1UL << i))
+        {
+            if ((values >> i) & 1)
+            {
+                set[group->pins[i] / 32] |= 1UL << (group->pins[i] % 32);
+            }
+            else
+            {
+                clear[group->pins[i] / 32] |= 1UL << (group->pins[i] % 32);
+            }
+        }
+    }
+
+    /* one atomic update per table word, readers never see a half written group */
+    for (i = 0; i < NOS_GPIO_WORDS; i++)
+    {
+        if ((set[i] | clear[i]) == 0)
+        {
+            continue;
+        }
+
+        old = __atomic_load_n(&gpio_shm->value[i], __ATOMIC_RELAXED);
+        do
+        {
+            new_value = (old & ~clear[i]) | set[i];
+        } while (!__atomic_compare_exchange_n(&gpio_shm->value[i], &old, new_value, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+        changed |= (old != new_value);
+        nos_gpio_record_word(i, old, new_value);
     }
+
+    /* one notification for the whole group */
+    if (changed)
+    {
+        nos_gpio_notify();
+    }
+
+    return GPIO_SUCCESS;
+}
+
+int32_t gpio_group_close(gpio_group_t* group)
+{
+    group->isOpen = GPIO_CLOSED;
     return GPIO_SUCCESS;
 }
 
@@ -17,7 +17,9 @@ ivv-itc@lists.nasa.gov
 
 #include "nos_link.h"
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 /* nos */
 #include <I2C/Client/CInterface.h>
@@ -51,9 +53,18 @@ static NE_I2CHandle* nos_get_i2c_device(int handle)
     return dev;
 }
 
+/*
+** NOS Engine calls block until the simulator answers and cannot be abandoned part way,
+** so the timeout arguments are accepted for API compatibility but not applied.
+*/
+
 int32_t i2c_master_init(i2c_bus_info_t* device)
 {
     int32_t status = I2C_SUCCESS;
+    device->cur_addr = I2C_ADDR_NONE;
+    device->retries = 0;
+    device->recover = 0;
+    device->pec = 0;
     if(device->handle >= 0 && device->handle < NUM_I2C_DEVICES)
     {
         /* get i2c device handle */
@@ -87,8 +98,8 @@ int32_t i2c_master_init(i2c_bus_info_t* device)
 }
 
 /* nos i2c transaction */
-int32_t i2c_master_transaction(i2c_bus_info_t* device, uint8_t addr, void * txbuf, uint8_t txlen,
-                               void * rxbuf, uint8_t rxlen, uint16_t timeout)
+int32_t i2c_master_transaction(i2c_bus_info_t* device, uint8_t addr, void * txbuf, uint16_t txlen,
+                               void * rxbuf, uint16_t rxlen, uint16_t timeout)
 {
     int32_t result = I2C_ERROR;
 
@@ -108,24 +119,84 @@ int32_t i2c_master_transaction(i2c_bus_info_t* device, uint8_t addr, void * txbu
     return result;
 }
 
+/* nos i2c read */
+int32_t i2c_read_transaction(i2c_bus_info_t* device, uint8_t addr, void * rxbuf, uint16_t rxlen, uint16_t timeout)
+{
+    return i2c_master_transaction(device, addr, NULL, 0, rxbuf, rxlen, timeout);
+}
+
+/* nos i2c write */
+int32_t i2c_write_transaction(i2c_bus_info_t* device, uint8_t addr, void * txbuf, uint16_t txlen, uint16_t timeout)
+{
+    return i2c_master_transaction(device, addr, txbuf, txlen, NULL, 0, timeout);
+}
+
 int32_t i2c_multiple_transaction(i2c_bus_info_t* device, uint8_t addr, struct i2c_rdwr_ioctl_data* rdwr_data, uint16_t timeout)
 {
-    int32_t result = I2C_ERROR;
-    uint32_t i;
+    int32_t result = I2C_SUCCESS;
+    uint32_t i = 0;
+    NE_I2CHandle *dev = nos_get_i2c_device(device->handle);
+    struct i2c_msg *wr;
+    struct i2c_msg *rd;
+    uint16_t msg_addr;
+
+    if (dev == NULL)
+    {
+        return I2C_ERROR;
+    }
 
-    for (i = 0; i < rdwr_data->nmsgs; i++)
+    /*
+    ** NOS Engine transactions are a write followed by a repeated start read, so a
+    ** write segment is combined with the read segment after it into one round trip.
+    ** Like I2C_RDWR each message carries its own address, the pair is only formed
+    ** when both messages go to the same slave.
+    */
+    while ((i < rdwr_data->nmsgs) && (result == I2C_SUCCESS))
     {
-        if (rdwr_data->msgs[i].flags == 0)
-        {   // Write
-            result = i2c_master_transaction(device, addr, (void*) rdwr_data->msgs[i].buf, (uint8_t) rdwr_data->msgs[i].len, (void*) NULL, 0, timeout);
+        wr = NULL;
+        rd = NULL;
+        msg_addr = rdwr_data->msgs[i].addr;
+        if ((rdwr_data->msgs[i].flags & I2C_M_RD) == 0)
+        {
+            wr = &rdwr_data->msgs[i++];
         }
-        else
-        {   // Read
-            result = i2c_master_transaction(device, addr, (void*) NULL, 0, (void*) rdwr_data->msgs[i].buf, (uint8_t) rdwr_data->msgs[i].len, timeout);
+        if ((i < rdwr_data->nmsgs) && (rdwr_data->msgs[i].flags & I2C_M_RD) && 
+            (rdwr_data->msgs[i].addr == msg_addr))
+        {
+            rd = &rdwr_data->msgs[i++];
         }
-        
-        if (result != I2C_SUCCESS)
+
+        if (NE_i2c_transaction(dev, (uint8_t) msg_addr, wr ? wr->buf : NULL, wr ? wr->len : 0, 
+                               rd ? rd->buf : NULL, rd ? rd->len : 0) != NE_I2C_SUCCESS)
         {
+            result = I2C_ERROR;
+        }
+    }
+
+    return result;
+}
+
+/* nos i2c batch, nos engine pairs the write and read of each operation */
+int32_t i2c_batch_transaction(i2c_bus_info_t* device, i2c_batch_op_t* ops, uint32_t count, uint16_t timeout)
+{
+    int32_t result = I2C_SUCCESS;
+    uint32_t i;
+
+    NE_I2CHandle *dev = nos_get_i2c_device((int)device->handle);
+    if(dev == NULL)
+    {
+        return I2C_ERROR;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if ((ops[i].txlen == 0) && (ops[i].rxlen == 0))
+        {
+            continue;
+        }
+        if (NE_i2c_transaction(dev, ops[i].addr, ops[i].txbuf, ops[i].txlen, ops[i].rxbuf, ops[i].rxlen) != NE_I2C_SUCCESS)
+        {
+            result = I2C_ERROR;
             break;
         }
     }
@@ -133,6 +204,22 @@ int32_t i2c_multiple_transaction(i2c_bus_info_t* device, uint8_t addr, struct i2
     return result;
 }
 
+/* nos i2c retries and recovery are recorded only, a simulated bus never loses arbitration */
+int32_t i2c_master_config(i2c_bus_info_t* device, uint8_t retries, uint8_t recover, uint32_t scl_pin, uint32_t sda_pin)
+{
+    device->retries = retries;
+    device->recover = recover;
+    device->scl_pin = scl_pin;
+    device->sda_pin = sda_pin;
+    return I2C_SUCCESS;
+}
+
+/* nos i2c bus recovery, a simulated bus never gets stuck */
+int32_t i2c_bus_recover(i2c_bus_info_t* device)
+{
+    return I2C_SUCCESS;
+}
+
 int32_t i2c_master_close(i2c_bus_info_t* device) 
 {
     if (device->handle >= 0)
@@ -147,3 +234,125 @@ int32_t i2c_master_close(i2c_bus_info_t* device)
     }
     return I2C_SUCCESS;
 }
+
+/* SMBus over a plain i2c transaction, the PEC covers both address bytes, the command and the data */
+static int32_t nos_smbus_read(i2c_bus_info_t* device, uint8_t addr, uint8_t cmd, uint8_t* data, uint16_t len, uint16_t timeout)
+{
+    uint8_t hdr[3];
+    uint8_t pec;
+
+    if (i2c_master_transaction(device, addr, &cmd, 1, data, len + (device->pec ? 1 : 0), timeout) != I2C_SUCCESS)
+    {
+        return I2C_ERROR;
+    }
+
+    if (device->pec)
+    {
+        hdr[0] = (uint8_t) (addr << 1);
+        hdr[1] = cmd;
+        hdr[2] = (uint8_t) ((addr << 1) | 1);
+        pec = smbus_pec(smbus_pec(0, hdr, sizeof(hdr)), data, len);
+        if (pec != data[len])
+        {
+            OS_printf("nos i2c smbus command 0x%X to address 0x%X PEC mismatch\n", cmd, addr);
+            return I2C_ERROR;
+        }
+    }
+
+    return I2C_SUCCESS;
+}
+
+static int32_t nos_smbus_write(i2c_bus_info_t* device, uint8_t addr, uint8_t cmd, const uint8_t* data, uint16_t len, uint16_t timeout)
+{
+    uint8_t txbuf[2 + SMBUS_BLOCK_MAX + 1];
+    uint8_t hdr = (uint8_t) (addr << 1);
+    uint16_t txlen = 1 + len;
+
+    txbuf[0] = cmd;
+    memcpy(&txbuf[1], data, len);
+    if (device->pec)
+    {
+        txbuf[txlen] = smbus_pec(smbus_pec(0, &hdr, 1), txbuf, txlen);
+        txlen++;
+    }
+
+    return i2c_master_transaction(device, addr, txbuf, txlen, NULL, 0, timeout);
+}
+
+int32_t smbus_read_byte_data(i2c_bus_info_t* device, uint8_t addr, uint8_t cmd, uint8_t* value, uint16_t timeout)
+{
+    uint8_t rxbuf[2];
+
+    if (nos_smbus_read(device, addr, cmd, rxbuf, 1, timeout) != I2C_SUCCESS)
+    {
+        return I2C_ERROR;
+    }
+    *value = rxbuf[0];
+
+    return I2C_SUCCESS;
+}
+
+int32_t smbus_write_byte_data(i2c_bus_info_t* device, uint8_t addr, uint8_t cmd, uint8_t value, uint16_t timeout)
+{
+    return nos_smbus_write(device, addr, cmd, &value, 1, timeout);
+}
+
+int32_t smbus_read_word_data(i2c_bus_info_t* device, uint8_t addr, uint8_t cmd, uint16_t* value, uint16_t timeout)
+{
+    uint8_t rxbuf[3];
+
+    if (nos_smbus_read(device, addr, cmd, rxbuf, 2, timeout) != I2C_SUCCESS)
+    {
+        return I2C_ERROR;
+    }
+    /* SMBus words go low byte first */
+    *value = (uint16_t) (rxbuf[0] | (rxbuf[1] << 8));
+
+    return I2C_SUCCESS;
+}
+
+int32_t smbus_write_word_data(i2c_bus_info_t* device, uint8_t addr, uint8_t cmd, uint16_t value, uint16_t timeout)
+{
+    uint8_t txbuf[2];
+
+    txbuf[0] = (uint8_t) (value & 0xFF);
+    txbuf[1] = (uint8_t) (value >> 8);
+
+    return nos_smbus_write(device, addr, cmd, txbuf, 2, timeout);
+}
+
+int32_t smbus_block_read(i2c_bus_info_t* device, uint8_t addr, uint8_t cmd, uint8_t* data, uint8_t* len, uint16_t timeout)
+{
+    uint8_t rxbuf[1 + SMBUS_BLOCK_MAX + 1];
+    uint8_t hdr[3];
+    uint8_t count;
+
+    /* The count byte comes first, so read the largest block and check the PEC over what the slave sent */
+    if (i2c_master_transaction(device, addr, &cmd, 1, rxbuf, sizeof(rxbuf), timeout) != I2C_SUCCESS)
+    {
+        return I2C_ERROR;
+    }
+
+    count = rxbuf[0];
+    if (count > SMBUS_BLOCK_MAX)
+    {
+        return I2C_ERROR;
+    }
+
+    if (device->pec)
+    {
+        hdr[0] = (uint8_t) (addr << 1);
+        hdr[1] = cmd;
+        hdr[2] = (uint8_t) ((addr << 1) | 1);
+        if (smbus_pec(smbus_pec(0, hdr, sizeof(hdr)), rxbuf, 1 + count) != rxbuf[1 + count])
+        {
+            OS_printf("nos i2c smbus command 0x%X to address 0x%X PEC mismatch\n", cmd, addr);
+            return I2C_ERROR;
+        }
+    }
+
+    memcpy(data, &rxbuf[1], count);
+    *len = count;
+
+    return I2C_SUCCESS;
+}
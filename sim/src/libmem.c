@@ -1,6 +1,4 @@
 #include <sys/mman.h>
-#include <sys/ipc.h>
-#include <sys/shm.h>
 #include <sys/stat.h>
 #include <stdio.h>
 #include <fcntl.h>
@@ -9,62 +7,314 @@
 #include <string.h>
 #include <stdint.h>
 #include <pthread.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "nos_link.h"
+#include "nos_uio.h"
 #include "libmem.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-pthread_mutex_t mutex;
+/* mapped regions of nos_mem_map, each with its own lock for the devmem calls */
+typedef struct {
+    uint8_t        *addr;
+    pthread_mutex_t mutex;
+} nos_mem_mapping_t;
+
+static nos_mem_mapping_t mem_mapping[NUM_MEM_REGIONS + 1];
+
+/* serializes adding entries to nos_mem_map, lookups read the published addr without it */
+static pthread_mutex_t mem_map_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* names of entries added at runtime */
+static char mem_map_names[NUM_MEM_REGIONS][32];
+
+/* addresses outside every entry live at their own offset in one sparse object spanning the 32-bit physical space */
+#define NOS_MEM_FALLBACK         NUM_MEM_REGIONS     /* index of the fallback window in mem_mapping */
+#define NOS_MEM_FALLBACK_NAME    "/hwlib_mem"
+#define NOS_MEM_FALLBACK_LENGTH  0x100000000ULL
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ * nos_mem_map_shm() -      Map a shared memory object, creating it if needed so flight software and simulators may
+ *                          start in either order. Pages are only backed once they are touched.
+ *
+ * Inputs:                  int32_t i:          Index into mem_mapping
+ *                          const char *name:   POSIX shared memory object name
+ *                          uint64_t length:    Length of the object
+ *
+ * Outputs:                 returns int32_t:    MEM_SUCCESS or MEM_ERROR
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static int32_t nos_mem_map_shm(int32_t i, const char *name, uint64_t length){
+    int   fd; 
+    void *map; 
+
+    fd = shm_open(name, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH); 
+    if(fd < 0) {
+        printf("LIBMEM SHM_OPEN %s ERROR %d\n", name, errno);
+        return MEM_ERROR; 
+    }
+
+    if(ftruncate(fd, (off_t)length) < 0) {
+        printf("LIBMEM FTRUNCATE %s ERROR %d\n", name, errno);
+        close(fd); 
+        return MEM_ERROR; 
+    }
+
+    map = mmap(NULL, (size_t)length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, fd, 0); 
+    close(fd); 
+    if(map == MAP_FAILED) {
+        printf("LIBMEM MMAP %s ERROR %d\n", name, errno);
+        return MEM_ERROR; 
+    }
+
+    pthread_mutex_init(&mem_mapping[i].mutex, NULL); 
+    __atomic_store_n(&mem_mapping[i].addr, (uint8_t*)map, __ATOMIC_RELEASE); 
+
+    return MEM_SUCCESS; 
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ * nos_mem_map_entry() -    Map one entry of nos_mem_map.
+ *
+ * Inputs:                  int32_t i:          Index into nos_mem_map
+ *
+ * Outputs:                 returns int32_t:    MEM_SUCCESS or MEM_ERROR
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static int32_t nos_mem_map_entry(int32_t i){
+    return nos_mem_map_shm(i, nos_mem_map[i].name, nos_mem_map[i].length); 
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ * nos_init_mem_link() -    Map every configured region of nos_mem_map once.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void nos_init_mem_link(void){
+    int32_t i; 
+
+    for(i = 0; i < NUM_MEM_REGIONS; i++) {
+        mem_mapping[i].addr = NULL; 
+        if((nos_mem_map[i].name != NULL) && (nos_mem_map[i].length != 0)) {
+            nos_mem_map_entry(i); 
+        }
+    }
+
+    /* the fallback window is mapped on first use */
+    mem_mapping[NOS_MEM_FALLBACK].addr = NULL; 
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ * nos_destroy_mem_link() - Unmap the regions mapped by nos_init_mem_link() or added since.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void nos_destroy_mem_link(void){
+    int32_t i; 
+
+    for(i = 0; i < NUM_MEM_REGIONS; i++) {
+        if(mem_mapping[i].addr != NULL) {
+            munmap(mem_mapping[i].addr, nos_mem_map[i].length); 
+            pthread_mutex_destroy(&mem_mapping[i].mutex); 
+            mem_mapping[i].addr = NULL; 
+        }
+    }
+
+    if(mem_mapping[NOS_MEM_FALLBACK].addr != NULL) {
+        munmap(mem_mapping[NOS_MEM_FALLBACK].addr, (size_t)NOS_MEM_FALLBACK_LENGTH); 
+        pthread_mutex_destroy(&mem_mapping[NOS_MEM_FALLBACK].mutex); 
+        mem_mapping[NOS_MEM_FALLBACK].addr = NULL; 
+    }
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ * nos_mem_lookup() - Find the mapped region holding a block.
+ *
+ * Inputs:          uint32_t addr:      Physical address of the block
+ *                  uint32_t length:    Length of the block
+ *
+ * Outputs:         returns int32_t:    Index into nos_mem_map, -1 if no mapped region holds the whole block
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static int32_t nos_mem_lookup(uint32_t addr, uint32_t length){
+    int32_t i; 
+
+    for(i = 0; i < NUM_MEM_REGIONS; i++) {
+        if((__atomic_load_n(&mem_mapping[i].addr, __ATOMIC_ACQUIRE) != NULL) && (addr >= nos_mem_map[i].base) &&
+           ((uint64_t)addr + length <= (uint64_t)nos_mem_map[i].base + nos_mem_map[i].length)) {
+            return i; 
+        }
+    }
+
+    return -1; 
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ * nos_mem_overlap() -  Find a mapped entry sharing any byte with a block.
+ *
+ * Inputs:              uint32_t addr:      Physical address of the block
+ *                      uint64_t length:    Length of the block
+ *
+ * Outputs:             returns int32_t:    Index into nos_mem_map, -1 if the block overlaps no mapped entry
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static int32_t nos_mem_overlap(uint32_t addr, uint64_t length){
+    int32_t i; 
+
+    for(i = 0; i < NUM_MEM_REGIONS; i++) {
+        if((__atomic_load_n(&mem_mapping[i].addr, __ATOMIC_ACQUIRE) != NULL) &&
+           ((uint64_t)addr < (uint64_t)nos_mem_map[i].base + nos_mem_map[i].length) &&
+           ((uint64_t)nos_mem_map[i].base < (uint64_t)addr + length)) {
+            return i; 
+        }
+    }
+
+    return -1; 
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ * nos_add_mem_region() -   Add and map an entry of nos_mem_map at runtime. The entry must not overlap a mapped one.
+ *
+ * Inputs:                  const char *name:   POSIX shared memory object name, copied
+ *                          uint32_t base:      Physical base address
+ *                          uint32_t length:    Length of the region
+ *
+ * Outputs:                 returns int32_t:    Index into nos_mem_map, -1 on failure
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+int32_t nos_add_mem_region(const char *name, uint32_t base, uint32_t length){
+    int32_t index = -1; 
+    int32_t i; 
+
+    if((name == NULL) || (length == 0) || ((uint64_t)base + length > 0x100000000ULL)) {
+        return -1; 
+    }
+
+    pthread_mutex_lock(&mem_map_mutex); 
+    if((i = nos_mem_overlap(base, length)) >= 0) {
+        printf("LIBMEM %s overlaps %s in the nos memory map\n", name, nos_mem_map[i].name);
+        pthread_mutex_unlock(&mem_map_mutex); 
+        return -1; 
+    }
+    for(i = 0; i < NUM_MEM_REGIONS; i++) {
+        if((mem_mapping[i].addr == NULL) && ((nos_mem_map[i].name == NULL) || (nos_mem_map[i].length == 0))) {
+            index = i; 
+            break; 
+        }
+    }
+
+    if(index < 0) {
+        printf("LIBMEM nos memory map is full, %s not added\n", name);
+    } else {
+        snprintf(mem_map_names[index], sizeof(mem_map_names[index]), "%s", name); 
+        nos_mem_map[index].name   = mem_map_names[index]; 
+        nos_mem_map[index].base   = base; 
+        nos_mem_map[index].length = length; 
+        if(nos_mem_map_entry(index) != MEM_SUCCESS) {
+            nos_mem_map[index].name   = NULL; 
+            nos_mem_map[index].length = 0; 
+            index = -1; 
+        }
+    }
+    pthread_mutex_unlock(&mem_map_mutex); 
+
+    return index; 
+}
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  *
- * get_shared_mem() -   Creates a shared memory segment and attaches that segment to an unused address.
- * 
- * Inputs:              uint32_t address:   Requested address
- *                      uint32_t length:    Length of memory request
+ * nos_mem_find() - Find the mapped region holding a block. A block outside every entry lives in the fallback window
+ *                  "/hwlib_mem" at offset addr, so any address still works. A block that is only partly inside an
+ *                  entry is rejected, its bytes would be split between two objects.
+ *
+ * Inputs:          uint32_t addr:      Physical address of the block
+ *                  uint32_t length:    Length of the block
  *
- * Outputs:             returns void *:     Address containing the shared memory segment. 
+ * Outputs:         returns int32_t:    Index into mem_mapping, -1 on failure
  *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
-void *get_shared_mem(uint32_t address, uint32_t length){
+static int32_t nos_mem_find(uint32_t addr, uint32_t length){
+    int32_t index; 
 
-    pthread_mutex_lock(&mutex);
+    if((index = nos_mem_lookup(addr, length)) >= 0) {
+        return index; 
+    }
 
-    // Creates shared memory segment or returns the identifier of the previously created segment.
-    int32_t shmid = shmget(address, length, IPC_CREAT | S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
-    if (shmid == -1) {
-        printf("LIBMEM SHMGET ERROR %d\n", errno);
-        return NULL;
+    if((uint64_t)addr + length > NOS_MEM_FALLBACK_LENGTH) {
+        printf("LIBMEM 0x%08X length %u runs past the 32-bit address space\n", addr, length);
+        return -1; 
+    }
+    if((index = nos_mem_overlap(addr, length)) >= 0) {
+        printf("LIBMEM 0x%08X length %u straddles %s in the nos memory map\n", addr, length, nos_mem_map[index].name);
+        return -1; 
     }
 
-    // Attaches shared memory segment to an unused page-aligned address chosen by the system
-    uint32_t *sh_mem_addr = (uint32_t*)shmat(shmid, NULL, 0);
-    if (sh_mem_addr == (uint32_t*)(-1)) {
-        printf("LIBMEM SHMAT ERROR %d\n", errno);
-        return NULL;
+    if(__atomic_load_n(&mem_mapping[NOS_MEM_FALLBACK].addr, __ATOMIC_ACQUIRE) == NULL) {
+        pthread_mutex_lock(&mem_map_mutex); 
+        if(mem_mapping[NOS_MEM_FALLBACK].addr == NULL) {
+            nos_mem_map_shm(NOS_MEM_FALLBACK, NOS_MEM_FALLBACK_NAME, NOS_MEM_FALLBACK_LENGTH); 
+        }
+        pthread_mutex_unlock(&mem_map_mutex); 
     }
 
-    return sh_mem_addr;
+    return (mem_mapping[NOS_MEM_FALLBACK].addr != NULL) ? NOS_MEM_FALLBACK : -1; 
 }
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  *  
- * detach_shared_mem() -   Detaches the shared memory segment.
+ * mem_region_open() -  Point a region at its window inside the memory map. Nothing is mapped per region.
  *  
- * Inputs:                 uint32_t:    Address of the shared memory segment.
+ * Inputs:              uint32_t base:          Physical base address
+ *                      uint32_t length:        Length of the window
+ *                      mem_region_t *region:   Region information, filled in on success
+ *
+ * Outputs:             returns int32_t:        MEM_SUCCESS or MEM_ERROR
  *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
-void detach_shared_mem(uint32_t *shared_addr){
-    while (shmdt((void*)shared_addr) == -1) {
-        printf("LIBMEM SHMDT ERROR %d\n", errno);
+int32_t mem_region_open(uint32_t base, uint32_t length, mem_region_t *region){
+    int32_t index; 
+
+    if((length == 0) || ((index = nos_mem_find(base, length)) < 0)) {
+        return MEM_ERROR; 
     }
-    pthread_mutex_unlock(&mutex);
+
+    region->base       = base; 
+    region->length     = length; 
+    region->map        = NULL; 
+    region->map_length = 0; 
+    region->addr       = mem_mapping[index].addr + (base - ((index == NOS_MEM_FALLBACK) ? 0 : nos_mem_map[index].base)); 
+    region->handle     = index; 
+    region->isOpen     = MEM_OPEN; 
+
+    return MEM_SUCCESS; 
 }
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  *  
- * devmem_write() - Higher-level function to write to shared memory. 
+ * mem_region_close() - Release a region, the memory map itself stays mapped.
+ *  
+ * Inputs:              mem_region_t *region:   Region information
+ *
+ * Outputs:             returns int32_t:        MEM_SUCCESS
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+int32_t mem_region_close(mem_region_t *region){
+    region->isOpen = MEM_CLOSED; 
+    return MEM_SUCCESS; 
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  
+ * devmem_write() - Higher-level function to write to shared memory. Only the region holding the block is locked.
  *
  * Inputs:          uint32_t addr:      Address to write to
  *                  uint8_t *in:        Input data to write
@@ -74,26 +324,26 @@ void detach_shared_mem(uint32_t *shared_addr){
  *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 int32_t devmem_write(uint32_t addr, uint8_t *in, int32_t length){
-	uint32_t *local_addr;
-    uint8_t byte;  
+    mem_region_t region; 
+    int32_t      status; 
 
-	if((local_addr = (uint32_t*)get_shared_mem(addr, length)) == NULL) {
-		return -1;  
+    if((length <= 0) || (mem_region_open(addr, length, &region) != MEM_SUCCESS)) {
+        return -1;  
     }
 
-    for(byte = 0; byte < length; byte++) {
-        local_addr[byte] = in[byte]; 
-    }
+    pthread_mutex_lock(&mem_mapping[region.handle].mutex); 
+    status = mem_region_copy_to(&region, 0, in, length); 
+    pthread_mutex_unlock(&mem_mapping[region.handle].mutex); 
 
-    detach_shared_mem(local_addr); 
+    mem_region_close(&region); 
 
-    return length; 
+    return (status == MEM_SUCCESS) ? length : -1; 
 }
 
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  *  
- * devmem_read() -  Higher-level function to read from shared memory. 
+ * devmem_read() -  Higher-level function to read from shared memory. Only the region holding the block is locked.
  *
  * Inputs:          uint32_t addr:      Address to read from
  *                  uint8_t *out:       Output buffer to read into
@@ -103,20 +353,157 @@ int32_t devmem_write(uint32_t addr, uint8_t *in, int32_t length){
  *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 int32_t devmem_read(uint32_t addr, uint8_t *out, int32_t length){
-	uint32_t *local_addr;
-    uint8_t byte;
+    mem_region_t region; 
+    int32_t      status; 
+
+    if((length <= 0) || (mem_region_open(addr, length, &region) != MEM_SUCCESS)) {
+        return -1;  
+    }
+
+    pthread_mutex_lock(&mem_mapping[region.handle].mutex); 
+    status = mem_region_copy_from(&region, 0, out, length); 
+    pthread_mutex_unlock(&mem_mapping[region.handle].mutex); 
+
+    mem_region_close(&region); 
+
+    return (status == MEM_SUCCESS) ? length : -1; 
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  
+ * mem_dma_open() - DMA buffers are entries of nos_mem_map named "/hwlib_<name>". The entry's base is reported as
+ *                  the physical address, so a simulated DMA engine finds the buffer through the same map.
+ *  
+ * Inputs:          const char *name:       Device name, e.g. "udmabuf0"
+ *                  mem_dma_buf_t *buf:     Buffer information, filled in on success
+ *
+ * Outputs:         returns int32_t:        MEM_SUCCESS or MEM_ERROR
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+int32_t mem_dma_open(const char *name, mem_dma_buf_t *buf){
+    char    shm_name[64]; 
+    int32_t i; 
+
+    snprintf(shm_name, sizeof(shm_name), "/hwlib_%s", name); 
+    for(i = 0; i < NUM_MEM_REGIONS; i++) {
+        if((mem_mapping[i].addr != NULL) && (strcmp(nos_mem_map[i].name, shm_name) == 0)) {
+            strncpy(buf->name, name, sizeof(buf->name) - 1); 
+            buf->name[sizeof(buf->name) - 1] = '\0'; 
+            buf->addr      = mem_mapping[i].addr; 
+            buf->phys_addr = nos_mem_map[i].base; 
+            buf->size      = nos_mem_map[i].length; 
+            buf->handle    = i; 
+            buf->isOpen    = MEM_OPEN; 
+            return MEM_SUCCESS; 
+        }
+    }
 
-	if((local_addr = (uint32_t*)get_shared_mem(addr, length)) == NULL) {
-		return -1;  
+    printf("LIBMEM DMA buffer %s is not in the nos memory map\n", shm_name);
+    return MEM_ERROR; 
+}
+
+int32_t mem_dma_close(mem_dma_buf_t *buf){
+    buf->isOpen = MEM_CLOSED; 
+    return MEM_SUCCESS; 
+}
+
+/* shared memory is coherent, a full barrier orders the CPU accesses against the simulator's */
+int32_t mem_dma_sync_for_cpu(mem_dma_buf_t *buf, size_t offset, size_t length){
+    if((buf->isOpen != MEM_OPEN) || (offset > buf->size) || (length > buf->size - offset)) {
+        return MEM_ERROR; 
     }
+    __atomic_thread_fence(__ATOMIC_SEQ_CST); 
+    return MEM_SUCCESS; 
+}
+
+int32_t mem_dma_sync_for_device(mem_dma_buf_t *buf, size_t offset, size_t length){
+    return mem_dma_sync_for_cpu(buf, offset, length); 
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  
+ * mem_uio_open() - Map the shared interrupt state of simulated /dev/uioN, see nos_uio.h.
+ *  
+ * Inputs:          uint32_t uio:           N of /dev/uioN
+ *                  mem_uio_t *device:      UIO information, filled in on success
+ *
+ * Outputs:         returns int32_t:        MEM_SUCCESS or MEM_ERROR
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+int32_t mem_uio_open(uint32_t uio, mem_uio_t *device){
+    nos_uio_shm_t *shm = nos_uio_shm_map(uio); 
 
-    for(byte = 0; byte < length; byte++) {
-        out[byte] = local_addr[byte]; 
+    if(shm == NULL) {
+        printf("LIBMEM UIO %u SHM ERROR %d\n", uio, errno);
+        return MEM_ERROR; 
     }
 
-    detach_shared_mem(local_addr); 
+    device->uio    = uio; 
+    device->handle = -1; 
+    device->shm    = shm; 
+    device->count  = __atomic_load_n(&shm->count, __ATOMIC_ACQUIRE); 
+    device->isOpen = MEM_OPEN; 
+
+    return MEM_SUCCESS; 
+}
+
+int32_t mem_uio_irq_enable(mem_uio_t *device){
+    if(device->isOpen != MEM_OPEN) {
+        return MEM_ERROR; 
+    }
+
+    __atomic_store_n(&((nos_uio_shm_t*)device->shm)->enabled, 1, __ATOMIC_RELEASE); 
+    return MEM_SUCCESS; 
+}
+
+int32_t mem_uio_wait(mem_uio_t *device, int32_t timeout_ms){
+    nos_uio_shm_t  *shm = (nos_uio_shm_t*)device->shm; 
+    struct timespec now; 
+    struct timespec ts; 
+    int64_t         deadline_ns = 0; 
+    int64_t         remaining_ns; 
+    uint32_t        count; 
+
+    if(device->isOpen != MEM_OPEN) {
+        return MEM_ERROR; 
+    }
+
+    if(timeout_ms >= 0) {
+        clock_gettime(CLOCK_MONOTONIC, &now); 
+        deadline_ns = ((int64_t)now.tv_sec * 1000000000LL) + now.tv_nsec + ((int64_t)timeout_ms * 1000000LL); 
+    }
+
+    /* a count that moved since the last wait is a pending interrupt, like a UIO read */
+    count = __atomic_load_n(&shm->count, __ATOMIC_ACQUIRE); 
+    while(count == device->count) {
+        /* spurious wakeups and signals only shorten the sleep, the deadline is absolute */
+        if(timeout_ms >= 0) {
+            clock_gettime(CLOCK_MONOTONIC, &now); 
+            remaining_ns = deadline_ns - (((int64_t)now.tv_sec * 1000000000LL) + now.tv_nsec); 
+            if(remaining_ns <= 0) {
+                return MEM_TIMEOUT_ERR; 
+            }
+            ts.tv_sec  = remaining_ns / 1000000000LL; 
+            ts.tv_nsec = remaining_ns % 1000000000LL; 
+        }
+
+        syscall(SYS_futex, &shm->count, FUTEX_WAIT, count, (timeout_ms >= 0) ? &ts : NULL, NULL, 0); 
+        count = __atomic_load_n(&shm->count, __ATOMIC_ACQUIRE); 
+    }
+
+    /* the interrupt stays masked until enabled again */
+    __atomic_store_n(&shm->enabled, 0, __ATOMIC_RELEASE); 
+    device->count = count; 
+    return MEM_SUCCESS; 
+}
+
+int32_t mem_uio_close(mem_uio_t *device){
+    if(device->isOpen == MEM_OPEN) {
+        munmap(device->shm, sizeof(nos_uio_shm_t)); 
+        device->isOpen = MEM_CLOSED; 
+    }
 
-    return length; 
+    return MEM_SUCCESS; 
 }
 
 #ifdef __cplusplus
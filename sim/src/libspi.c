@@ -18,6 +18,9 @@ ivv-itc@lists.nasa.gov
 #include "nos_link.h"
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 #include <pthread.h>
 
 /* nos */
@@ -30,9 +33,17 @@ ivv-itc@lists.nasa.gov
 pthread_mutex_t spi_bus_mutex[MAX_SPI_BUSES];
 uint32_t handle_count = 0;
 
-/* spi device handles */
+/* spi bus arbitration statistics, each protected by its own short lived stats mutex
+   so a reader never waits behind the bus hold it is measuring */
+static spi_bus_stats_t spi_bus_stats[MAX_SPI_BUSES];
+static pthread_mutex_t spi_stats_mutex[MAX_SPI_BUSES];
+
+/* spi device handles, indexed by SPI_DEVICE_INDEX(bus, cs) to match nos_spi_connection */
 static NE_SpiHandle *spi_device[NUM_SPI_DEVICES] = {0};
 
+/* largest run of transfers combined into a single nos engine transaction */
+#define NOS_SPI_BATCH_BYTES 1024
+
 /* public prototypes */
 void nos_init_spi_link(void);
 void nos_destroy_spi_link(void);
@@ -40,18 +51,96 @@ void nos_destroy_spi_link(void);
 /* private prototypes */
 static NE_SpiHandle* nos_get_spi_device(spi_info_t* device);
 
+static uint64_t spi_time_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+}
+
+/* record the new bus holder, called with the bus mutex held */
+static void spi_hold_begin(uint8_t bus, uint8_t cs)
+{
+    pthread_mutex_lock(&spi_stats_mutex[bus]);
+    spi_bus_stats[bus].holder = cs;
+    spi_bus_stats[bus].hold_start_ns = spi_time_ns();
+    pthread_mutex_unlock(&spi_stats_mutex[bus]);
+}
+
+/* account the finished hold, called before the bus mutex is released */
+static void spi_hold_end(uint8_t bus, uint8_t cs)
+{
+    spi_bus_stats_t* stats = &spi_bus_stats[bus];
+    spi_hold_stats_t* cs_stats;
+    uint64_t held_ns;
+    uint32_t max_hold_us;
+    int report = 0;
+
+    pthread_mutex_lock(&spi_stats_mutex[bus]);
+    if (stats->holder != cs)
+    {
+        pthread_mutex_unlock(&spi_stats_mutex[bus]);
+        return;
+    }
+
+    held_ns = spi_time_ns() - stats->hold_start_ns;
+    stats->holder = SPI_BUS_FREE;
+
+    if (cs >= MAX_SPI_CHIP_SELECTS)
+    {
+        pthread_mutex_unlock(&spi_stats_mutex[bus]);
+        return;
+    }
+
+    cs_stats = &stats->cs[cs];
+    cs_stats->hold_count++;
+    cs_stats->total_hold_ns += held_ns;
+    if (held_ns > cs_stats->max_hold_ns)
+    {
+        cs_stats->max_hold_ns = held_ns;
+    }
+
+    max_hold_us = stats->max_hold_us;
+    if ((max_hold_us != 0) && (held_ns > ((uint64_t) max_hold_us * 1000)))
+    {
+        // don't spam
+        report = (cs_stats->overrun_count++ < 10);
+    }
+    pthread_mutex_unlock(&spi_stats_mutex[bus]);
+
+    if (report)
+    {
+        OS_printf("HWLIB: spi bus %d cs %d held for %llu us, limit is %u us\n", bus, cs,
+                  (unsigned long long) (held_ns / 1000), max_hold_us);
+    }
+}
+
 /* initialize nos engine spi link */
 void nos_init_spi_link(void)
 {
-    // Init the mutexes for chip select
+    pthread_mutexattr_t attr;
     int i;
+
+    // Priority inheritance keeps a low priority holder from stalling high priority users of the bus
+    pthread_mutexattr_init(&attr);
+    if (pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT) != 0)
+    {
+        OS_printf("HWLIB: spi mutex priority inheritance not supported\n");
+    }
+
+    // Init the mutexes for chip select
     for(i = 0; i < MAX_SPI_BUSES; i++)
     {
-        if (pthread_mutex_init(&spi_bus_mutex[i], NULL) != 0)
+        if (pthread_mutex_init(&spi_bus_mutex[i], &attr) != 0)
         {
             OS_printf("HWLIB: Create spi mutex error for spi bus %d", i);
         }
+        pthread_mutex_init(&spi_stats_mutex[i], NULL);
+        spi_bus_stats[i].holder = SPI_BUS_FREE;
     }
+
+    pthread_mutexattr_destroy(&attr);
 }
 
 /* destroy nos engine spi link */
@@ -59,15 +148,20 @@ void nos_destroy_spi_link(void)
 {
     /* clean up spi buses */
     int i;
-    for(i = 0; i < MAX_SPI_BUSES; i++)
+    for(i = 0; i < NUM_SPI_DEVICES; i++)
     {
         NE_SpiHandle *dev = spi_device[i];
         if(dev) NE_spi_close(&dev);
+        spi_device[i] = NULL;
+    }
 
+    for(i = 0; i < MAX_SPI_BUSES; i++)
+    {
         if (pthread_mutex_destroy(&spi_bus_mutex[i]) != 0)
         {
             OS_printf("HWLIB: Destroy spi mutex error for spi bus %d", i);
         }
+        pthread_mutex_destroy(&spi_stats_mutex[i]);
     }
 }
 
@@ -75,26 +169,34 @@ void nos_destroy_spi_link(void)
 int32_t spi_init_dev(spi_info_t* device)
 {
     int     status = SPI_SUCCESS;
+    int32_t index;
+
+    if ((device->bus >= MAX_SPI_BUSES) || (device->cs >= MAX_SPI_CHIP_SELECTS))
+    {
+        status = SPI_ERR_INVAL_BUS;
+        OS_printf("HWLIB: Open SPI device \"%s\" error %d, bus or chip select invalid!", device->deviceString, status);
+        return status;
+    }
 
+    /* the handle is the fixed index of the bus and chip select connection */
+    index = SPI_DEVICE_INDEX(device->bus, device->cs);
 
     pthread_mutex_lock(&spi_bus_mutex[device->bus]);
     
     /* get spi device handle */
-    NE_SpiHandle **dev = &spi_device[device->handle];
+    NE_SpiHandle **dev = &spi_device[index];
     if(*dev == NULL)
     {
         /* get nos spi connection params */
-        const nos_connection_t *con = &nos_spi_connection[(device->bus * 10) + device->cs];
+        const nos_connection_t *con = &nos_spi_connection[index];
 
         /* try to initialize master */
         *dev = NE_spi_init_master3(hub, con->uri, con->bus);
-        if(*dev)
-        {
-            status = SPI_SUCCESS;
-        }
-        else
+        if(*dev == NULL)
         {
             pthread_mutex_unlock(&spi_bus_mutex[device->bus]);
+            status = SPI_ERR_FILE_OPEN;
+            device->isOpen = SPI_DEVICE_CLOSED;
             OS_printf("HWLIB: Open SPI device \"%s\" error %d", device->deviceString, status);
             return status;
         }
@@ -102,34 +204,46 @@ int32_t spi_init_dev(spi_info_t* device)
 
     pthread_mutex_unlock(&spi_bus_mutex[device->bus]);
 
-    // Set open flag
+    // Set handle and open flag
+    device->handle = index;
     device->isOpen = SPI_DEVICE_OPEN;
 
     return status;
 }
 
-/* get spi device */
+/* get spi device, spi_init_dev must already have opened it */
 static NE_SpiHandle* nos_get_spi_device(spi_info_t* device)
 {
     NE_SpiHandle *dev = NULL;
-    if(device->handle < NUM_SPI_DEVICES)
+    if((device->handle >= 0) && (device->handle < NUM_SPI_DEVICES))
     {
         dev = spi_device[device->handle];
-        if(dev == NULL)
-        {
-            spi_init_dev(device);
-            dev = spi_device[device->handle];
-        }
     }
     return dev;
 }
 
+/* nos engine transfers whole bytes, so only byte multiples up to 32 bits are valid */
+static int32_t nos_check_spi_bits(uint8_t bits)
+{
+    if ((bits == 0) || (((bits % 8) == 0) && (bits <= 32)))
+    {
+        return SPI_SUCCESS;
+    }
+    return SPI_ERR_WR_BPW;
+}
+
 /* nos spi chip select */
 int32_t spi_select_chip(spi_info_t* device)
 {
     int32_t status = SPI_SUCCESS;
 
+    if (device->bus >= MAX_SPI_BUSES)
+    {
+        return SPI_ERR_INVAL_BUS;
+    }
+
     pthread_mutex_lock(&spi_bus_mutex[device->bus]);
+    spi_hold_begin(device->bus, device->cs);
 
     NE_SpiHandle *dev = nos_get_spi_device(device);
     if(dev)
@@ -145,7 +259,10 @@ int32_t spi_unselect_chip(spi_info_t* device)
 {
     int32_t status = SPI_SUCCESS;
 
-    pthread_mutex_unlock(&spi_bus_mutex[device->bus]);
+    if (device->bus >= MAX_SPI_BUSES)
+    {
+        return SPI_ERR_INVAL_BUS;
+    }
 
     NE_SpiHandle *dev = nos_get_spi_device(device);
     if(dev)
@@ -153,9 +270,42 @@ int32_t spi_unselect_chip(spi_info_t* device)
         NE_spi_unselect_chip(dev);
     }
 
+    spi_hold_end(device->bus, device->cs);
+    pthread_mutex_unlock(&spi_bus_mutex[device->bus]);
+
     return status;
 }
 
+/* nos spi max hold time */
+int32_t spi_set_max_hold_time(uint8_t bus, uint32_t max_hold_us)
+{
+    if (bus >= MAX_SPI_BUSES)
+    {
+        return SPI_ERR_INVAL_BUS;
+    }
+
+    pthread_mutex_lock(&spi_stats_mutex[bus]);
+    spi_bus_stats[bus].max_hold_us = max_hold_us;
+    pthread_mutex_unlock(&spi_stats_mutex[bus]);
+
+    return SPI_SUCCESS;
+}
+
+/* nos spi bus statistics */
+int32_t spi_get_bus_stats(uint8_t bus, spi_bus_stats_t* stats)
+{
+    if (bus >= MAX_SPI_BUSES)
+    {
+        return SPI_ERR_INVAL_BUS;
+    }
+
+    pthread_mutex_lock(&spi_stats_mutex[bus]);
+    memcpy(stats, &spi_bus_stats[bus], sizeof(spi_bus_stats_t));
+    pthread_mutex_unlock(&spi_stats_mutex[bus]);
+
+    return SPI_SUCCESS;
+}
+
 /* nos spi write */
 int32_t spi_write(spi_info_t* device, uint8_t data[], const uint32_t numBytes)
 {
@@ -192,14 +342,115 @@ int32_t spi_read(spi_info_t* device, uint8_t data[], const uint32_t numBytes)
 
 int32_t spi_transaction(spi_info_t* device, uint8_t *txBuff, uint8_t * rxBuffer, uint32_t length, uint16_t delay, uint8_t bits, uint8_t deselect)
 {
-    int status = SPI_SUCCESS;
+    spi_transfer_t xfer;
+
+    xfer.txBuff = txBuff;
+    xfer.rxBuff = rxBuffer;
+    xfer.length = length;
+    xfer.delay = delay;
+    xfer.bits = bits;
+    xfer.deselect = deselect;
+
+    return spi_multiple_transaction(device, &xfer, 1);
+}
+
+/* 
+** Consecutive transfers are packed into one nos engine transaction until a transfer
+** asks for a delay or a chip select toggle, matching the spidev message semantics.
+** A deselect on the last transfer keeps SS active, which is already the case here
+** since the chip select is owned by spi_select_chip/spi_unselect_chip.
+*/
+int32_t spi_multiple_transaction(spi_info_t* device, spi_transfer_t* xfers, uint32_t count)
+{
+    int      status = SPI_SUCCESS;
+    uint8_t  tx[NOS_SPI_BATCH_BYTES];
+    uint8_t  rx[NOS_SPI_BATCH_BYTES];
+    uint32_t first = 0;
+    uint32_t used = 0;
+    uint32_t i;
+    uint32_t j;
+
+    if ((count == 0) || (count > MAX_SPI_TRANSFERS))
+    {
+        return SPI_ERROR;
+    }
 
     NE_SpiHandle *dev = nos_get_spi_device(device);
-    if(dev)
+    if(dev == NULL)
     {
-        if(NE_spi_transaction(dev, txBuff, length, rxBuffer, length) != NE_SPI_SUCCESS)
+        return SPI_ERR_FILE_HANDLE;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        status = nos_check_spi_bits(xfers[i].bits);
+        if (status != SPI_SUCCESS)
         {
-            status = SPI_ERROR;
+            return status;
+        }
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (xfers[i].length > NOS_SPI_BATCH_BYTES)
+        {
+            // Too large to combine, send on its own
+            if (NE_spi_transaction(dev, xfers[i].txBuff, xfers[i].length, xfers[i].rxBuff, xfers[i].length) != NE_SPI_SUCCESS)
+            {
+                return SPI_ERROR;
+            }
+            first = i + 1;
+        }
+        else
+        {
+            if (xfers[i].txBuff)
+            {
+                memcpy(&tx[used], xfers[i].txBuff, xfers[i].length);
+            }
+            else
+            {
+                memset(&tx[used], 0, xfers[i].length);
+            }
+            used += xfers[i].length;
+
+            // Flush the batch at a delay, a chip select toggle, the end, or when the next transfer will not fit
+            if ((xfers[i].delay == 0) && (xfers[i].deselect == 0) && (i + 1 < count) &&
+                (used + xfers[i + 1].length <= NOS_SPI_BATCH_BYTES))
+            {
+                continue;
+            }
+
+            if (used > 0)
+            {
+                if (NE_spi_transaction(dev, tx, used, rx, used) != NE_SPI_SUCCESS)
+                {
+                    return SPI_ERROR;
+                }
+
+                // Scatter the received bytes back to each transfer
+                used = 0;
+                for (j = first; j <= i; j++)
+                {
+                    if (xfers[j].rxBuff)
+                    {
+                        memcpy(xfers[j].rxBuff, &rx[used], xfers[j].length);
+                    }
+                    used += xfers[j].length;
+                }
+            }
+            used = 0;
+            first = i + 1;
+        }
+
+        if (xfers[i].delay)
+        {
+            usleep(xfers[i].delay);
+        }
+
+        if (xfers[i].deselect && (i + 1 < count))
+        {
+            NE_spi_unselect_chip(dev);
+            NE_spi_select_chip(dev, device->cs);
         }
     }
 
@@ -208,15 +459,12 @@ int32_t spi_transaction(spi_info_t* device, uint8_t *txBuff, uint8_t * rxBuffer,
 
 int32_t spi_close_device(spi_info_t* device)
 {
-	if (device->handle >= 0)
+    NE_SpiHandle *dev = nos_get_spi_device(device);
+    if(dev)
     {
-        NE_SpiHandle *dev = nos_get_spi_device(device);
-        if(dev)
-        {
-            NE_spi_close(&dev);
-            spi_device[device->handle] = 0;
-            device-> isOpen = SPI_DEVICE_CLOSED;
-        }
+        NE_spi_close(&dev);
+        spi_device[device->handle] = 0;
+        device->isOpen = SPI_DEVICE_CLOSED;
     }
     return OS_SUCCESS;
 }
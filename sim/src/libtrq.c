@@ -16,8 +16,12 @@ ivv-itc@lists.nasa.gov
 */
 
 #include "nos_link.h"
+#include "nos_trq.h"
 #include <stdint.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <endian.h>
 #include <sys/socket.h> 
 #include <arpa/inet.h> 
 #include <netinet/in.h>
@@ -27,18 +31,57 @@ ivv-itc@lists.nasa.gov
 
 /* hwlib API */
 #include "libtrq.h"
+#include "libsocket.h"
 
 static int num_conn_errors = 0;
 static int num_send_errors = 0;
-static const int PORT = 14242;
-static int sockfd = 0;
+static pthread_mutex_t trq_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int trq_refs = 0;
+static int sockfd = -1;
 static struct sockaddr_in servaddr;
 
-int32_t trq_update(trq_info_t* device)
+#ifdef NOS_TRQ_BINARY
+/* binary nos_trq_packet_t, see nos_trq.h */
+typedef nos_trq_packet_t nos_trq_msg_t;
+
+static uint32_t trq_seq = 0;
+
+/* fill one axis of the binary packet */
+static void nos_trq_format(nos_trq_msg_t* msg, uint8_t index, trq_info_t* device)
+{
+    nos_trq_axis_t* axis = &msg->axis[index];
+
+    axis->trq_num = device->trq_num;
+    axis->positive_direction = device->positive_direction ? 1 : 0;
+    axis->reserved = 0;
+    axis->time_high_ns = htonl(device->timer_high_ns);
+    axis->period_ns = htonl(device->timer_period_ns);
+}
+
+/* complete the header, returns the bytes to send */
+static size_t nos_trq_finish(nos_trq_msg_t* msg, uint8_t count)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    msg->magic = htonl(NOS_TRQ_MAGIC);
+    msg->seq = htonl(__atomic_add_fetch(&trq_seq, 1, __ATOMIC_RELAXED));
+    msg->timestamp_ns = htobe64(((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec);
+    msg->count = count;
+    memset(msg->reserved, 0, sizeof(msg->reserved));
+
+    return NOS_TRQ_PACKET_SIZE(count);
+}
+#else
+/* a single text line, the existing MTB sim reads one line per datagram */
+typedef struct {
+    char   text[32];
+    size_t length;
+} nos_trq_msg_t;
+
+/* format the torquer as a "<trq_num> <signed percent high>" line, index is always 0 */
+static void nos_trq_format(nos_trq_msg_t* msg, uint8_t index, trq_info_t* device)
 {
-    int32_t status = TRQ_SUCCESS;
-    ssize_t bytes_sent;
-    char message[512];
     float percent_high_dir = 100.0 * device->timer_high_ns / device->timer_period_ns;
 
     // Take into account the direction
@@ -47,17 +90,39 @@ int32_t trq_update(trq_info_t* device)
         percent_high_dir = percent_high_dir * -1;
     }
 
-    // Send to MTB sim, MTB sim must then calculate A-m^2
-    sprintf(message, "%d %f\n", device->trq_num, percent_high_dir);
+    msg->length = snprintf(msg->text, sizeof(msg->text), "%d %f\n", device->trq_num, percent_high_dir);
+}
+
+static size_t nos_trq_finish(nos_trq_msg_t* msg, uint8_t count)
+{
+    return msg->length;
+}
+#endif
+
+/* one datagram is applied by the MTB sim on one tick */
+static int32_t nos_trq_send(nos_trq_msg_t* msg, uint8_t count)
+{
+    int32_t status = TRQ_SUCCESS;
+    size_t length = nos_trq_finish(msg, count);
+    ssize_t bytes_sent = -1;
+    int fd;
+
+    // Hold the lock so trq_close cannot release the socket mid send
+    pthread_mutex_lock(&trq_mutex);
+    fd = sockfd;
+    if (fd >= 0)
+    {
+        bytes_sent = sendto(fd, msg, length, MSG_CONFIRM | MSG_DONTWAIT, (const struct sockaddr *)&servaddr, sizeof(servaddr));
+    }
+    pthread_mutex_unlock(&trq_mutex);
 
-    if (sockfd >= 0) 
+    if (fd >= 0) 
     {
-        bytes_sent = sendto(sockfd, message, strlen(message), MSG_CONFIRM | MSG_DONTWAIT, (const struct sockaddr *)&servaddr, sizeof(servaddr));
-        if ((bytes_sent < 0) || ((size_t)bytes_sent != strlen(message))) 
+        if ((bytes_sent < 0) || ((size_t)bytes_sent != length)) 
         {
             if (num_send_errors++ < 10) 
             { // don't spam
-                printf("NOS command_torquer:  Only sent %ld bytes of %ld bytes.  Message was:  %s\n", bytes_sent, strlen(message), message);
+                printf("NOS command_torquer:  Only sent %ld bytes of %ld bytes.\n", bytes_sent, length);
             }
             status = TRQ_ERROR;
         }
@@ -65,7 +130,7 @@ int32_t trq_update(trq_info_t* device)
     {
         if (num_conn_errors++ < 10) 
         { // don't spam
-            printf("NOS command_torquer:  Socket not connected (%d).\n", sockfd);
+            printf("NOS command_torquer:  Socket not connected (%d).\n", fd);
         }
         status = TRQ_ERROR;
     }
@@ -73,6 +138,16 @@ int32_t trq_update(trq_info_t* device)
     return status;
 }
 
+int32_t trq_update(trq_info_t* device)
+{
+    nos_trq_msg_t msg;
+
+    // Send to MTB sim, MTB sim must then calculate A-m^2
+    nos_trq_format(&msg, 0, device);
+
+    return nos_trq_send(&msg, 1);
+}
+
 int32_t trq_set_time_high(trq_info_t* device, uint32_t new_time)
 {
     int32_t status = TRQ_SUCCESS;
@@ -102,50 +177,166 @@ int32_t trq_set_direction(trq_info_t* device, bool direction)
     return status;
 }
 
+int32_t trq_update_pending(trq_info_t* device, bool* pending)
+{
+    // the MTB sim applies every datagram immediately
+    *pending = false;
+    return TRQ_SUCCESS;
+}
+
 int32_t trq_init(trq_info_t* device)
 {
     int32_t status = TRQ_SUCCESS;
-    device->enabled = true;
+    char ip[INET_ADDRSTRLEN];
+
     device->timer_high_ns = 0;  // no pulse
 
-    // int socket(int domain, int type, int protocol);
-    // int close(int fd)
+    // All torquers share one socket, the first init opens it and the last close releases it
+    pthread_mutex_lock(&trq_mutex);
+    if (device->enabled == false)
+    {
+        if (trq_refs == 0)
+        {
+            memset(&servaddr, 0, sizeof(servaddr));
+            servaddr.sin_family = AF_INET;
+            servaddr.sin_port = htons(nos_trq_endpoint.port);
+            if (HostToIp(nos_trq_endpoint.host, ip) != 0)
+            {
+                OS_printf("NOS trq_init:  Failed to resolve %s\n", nos_trq_endpoint.host);
+                status = TRQ_CONNECT_ERR;
+            }
+            else
+            {
+                servaddr.sin_addr.s_addr = inet_addr(ip);
+                if ((sockfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0)
+                {
+                    OS_printf("NOS trq_init:  Failed to create UDP socket\n");
+                    status = TRQ_CONNECT_ERR;
+                }
+            }
+        }
 
-    if (sockfd == 0) {
-        if ((sockfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
-            OS_printf("NOS trq_init:  Failed to create UDP socket\n");
+        if (status == TRQ_SUCCESS)
+        {
+            trq_refs++;
+            device->enabled = true;
         }
-    
-        memset(&servaddr, 0, sizeof(servaddr));
-        // Filling server information 
-        servaddr.sin_family = AF_INET;
-        servaddr.sin_port = htons(PORT);
-        servaddr.sin_addr.s_addr = INADDR_ANY;
     }
+    pthread_mutex_unlock(&trq_mutex);
 
     return status;
 }
 
+int32_t trq_command_ns(trq_info_t* device, uint32_t time_high_ns, bool pos_dir)
+{
+    // A closed torquer must not keep using the socket shared with the others
+    if (!device->enabled)
+    {
+        return TRQ_ERROR;
+    }
+
+    if (time_high_ns > device->timer_period_ns)
+    {
+        printf("trq_command: Error setting time high greater than the period! \n");
+        return TRQ_TIME_HIGH_VAL_ERR;
+    }
+
+    device->timer_high_ns = time_high_ns;
+    device->positive_direction = pos_dir;
+
+    return trq_update(device);
+}
+
+int32_t trq_command_q16(trq_info_t* device, uint32_t duty_q16, bool pos_dir)
+{
+    uint32_t time_high_ns;
+
+    if (trq_q16_to_ns(device, duty_q16, &time_high_ns) != TRQ_SUCCESS)
+    {
+        return TRQ_ERROR;
+    }
+
+    return trq_command_ns(device, time_high_ns, pos_dir);
+}
+
 int32_t trq_command(trq_info_t* device, uint8_t percent_high, bool pos_dir)
 {
-    int32_t status = TRQ_SUCCESS;
+    uint32_t time_high_ns;
 
-    // Calculate time high
-    if (percent_high > 100)
+    if (trq_percent_to_ns(device, percent_high, &time_high_ns) != TRQ_SUCCESS)
     {
-        printf("trq_command: Error setting percent high greater than 100! \n");
         return TRQ_ERROR;
     }
 
-    device->timer_high_ns = device->timer_period_ns * (percent_high / 100.00);
-    device->positive_direction = pos_dir;
-    status = trq_update(device);
+    return trq_command_ns(device, time_high_ns, pos_dir);
+}
+
+int32_t trq_command_set(trq_cmd_t* cmds, uint8_t count)
+{
+#ifdef NOS_TRQ_BINARY
+    nos_trq_msg_t msg;
+#else
+    int32_t status = TRQ_SUCCESS;
+#endif
+    uint32_t time_high_ns[TRQ_MAX_DEVICES];
+    uint8_t i;
+
+    if (count > TRQ_MAX_DEVICES)
+    {
+        return TRQ_NUM_ERR;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (!cmds[i].device->enabled)
+        {
+            return TRQ_ERROR;
+        }
+        if (trq_q16_to_ns(cmds[i].device, cmds[i].duty_q16, &time_high_ns[i]) != TRQ_SUCCESS)
+        {
+            return TRQ_ERROR;
+        }
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        cmds[i].device->timer_high_ns = time_high_ns[i];
+        cmds[i].device->positive_direction = cmds[i].pos_dir;
+    }
+
+#ifdef NOS_TRQ_BINARY
+    // All axes go out in one packet, so the MTB sim applies them on the same tick
+    for (i = 0; i < count; i++)
+    {
+        nos_trq_format(&msg, i, cmds[i].device);
+    }
+
+    return (count > 0) ? nos_trq_send(&msg, count) : TRQ_SUCCESS;
+#else
+    // The MTB sim reads one line per datagram, so each axis is sent on its own
+    for (i = 0; i < count; i++)
+    {
+        if (trq_update(cmds[i].device) != TRQ_SUCCESS)
+        {
+            status = TRQ_ERROR;
+        }
+    }
 
     return status;
+#endif
 }
 
 void trq_close(trq_info_t* device)
 {
-    device->enabled = false;
-    close(sockfd);
+    pthread_mutex_lock(&trq_mutex);
+    if (device->enabled == true)
+    {
+        device->enabled = false;
+        if ((--trq_refs == 0) && (sockfd >= 0))
+        {
+            close(sockfd);
+            sockfd = -1;
+        }
+    }
+    pthread_mutex_unlock(&trq_mutex);
 }
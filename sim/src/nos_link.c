@@ -155,6 +155,45 @@ nos_connection_t nos_spi_connection[NUM_SPI_DEVICES] = {
     {"tcp://nos_engine_server:12000", "spi_29"}
 };
 
+/* nos memory map, free entries are used by nos_add_mem_region */
+nos_mem_region_t nos_mem_map[NUM_MEM_REGIONS] = {
+    {"/hwlib_mem_0", 0x40000000, 0x00100000},
+    {"/hwlib_mem_1", 0x80000000, 0x00100000},
+    {"/hwlib_udmabuf0", 0x70000000, 0x00400000},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0}
+};
+
+/* mtb sim torquer command endpoint */
+nos_udp_endpoint_t nos_trq_endpoint = {"localhost", 14242};
+
 /* common transport hub */
 NE_TransportHub *hub = NULL;
 
@@ -166,6 +205,10 @@ extern void nos_init_can_link(void);
 extern void nos_destroy_can_link(void);
 extern void nos_init_spi_link(void);
 extern void nos_destroy_spi_link(void);
+extern void nos_init_gpio_link(void);
+extern void nos_destroy_gpio_link(void);
+extern void nos_init_mem_link(void);
+extern void nos_destroy_mem_link(void);
 
 /* initialize nos engine link */
 void nos_init_link(void)
@@ -178,6 +221,8 @@ void nos_init_link(void)
     /* initialize buses */
     /* can, i2c, and uart do not need init for mutex*/
     nos_init_spi_link();
+    nos_init_gpio_link();
+    nos_init_mem_link();
 }
 
 /* destroy nos engine link */
@@ -190,6 +235,8 @@ void nos_destroy_link(void)
     nos_destroy_i2c_link();
     nos_destroy_can_link();
     nos_destroy_spi_link();
+    nos_destroy_gpio_link();
+    nos_destroy_mem_link();
 
     /* destroy transport hub */
     NE_destroy_transport_hub(&hub);
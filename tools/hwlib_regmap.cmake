@@ -0,0 +1,40 @@
+# hwlib register map code generation
+#
+# hwlib_regmap(<target> <spec>...)
+#   Generates <name>_regs.h, <name> being the regmap name, for each register map description (see tools/regmap_gen.py)
+#   into the current binary directory, adds it to the include path and makes <target>
+#   depend on it, so the header is regenerated whenever the description changes.
+
+set(HWLIB_REGMAP_GEN ${CMAKE_CURRENT_LIST_DIR}/regmap_gen.py)
+find_program(HWLIB_PYTHON NAMES python3 python)
+
+function(hwlib_regmap TARGET_NAME)
+    if(NOT HWLIB_PYTHON)
+        message(FATAL_ERROR "hwlib_regmap: python is required to generate register maps")
+    endif()
+
+    set(REGMAP_DIR ${CMAKE_CURRENT_BINARY_DIR}/regmap)
+    file(MAKE_DIRECTORY ${REGMAP_DIR})
+    include_directories(${REGMAP_DIR})
+
+    foreach(SPEC ${ARGN})
+        get_filename_component(SPEC_PATH ${SPEC} ABSOLUTE)
+
+        # the header is named after the regmap name in the description, as regmap_gen.py does
+        execute_process(COMMAND ${HWLIB_PYTHON} ${HWLIB_REGMAP_GEN} --print-name ${SPEC_PATH}
+                        OUTPUT_VARIABLE SPEC_NAME
+                        RESULT_VARIABLE SPEC_RESULT)
+        if(NOT SPEC_RESULT EQUAL 0)
+            message(FATAL_ERROR "hwlib_regmap: invalid register map ${SPEC}")
+        endif()
+        set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS ${SPEC_PATH})
+        set(REGMAP_HEADER ${REGMAP_DIR}/${SPEC_NAME}_regs.h)
+
+        add_custom_command(OUTPUT ${REGMAP_HEADER}
+                           COMMAND ${HWLIB_PYTHON} ${HWLIB_REGMAP_GEN} -o ${REGMAP_HEADER} ${SPEC_PATH}
+                           DEPENDS ${SPEC_PATH} ${HWLIB_REGMAP_GEN}
+                           COMMENT "Generating register map ${SPEC_NAME}_regs.h")
+        add_custom_target(${TARGET_NAME}_${SPEC_NAME}_regmap DEPENDS ${REGMAP_HEADER})
+        add_dependencies(${TARGET_NAME} ${TARGET_NAME}_${SPEC_NAME}_regmap)
+    endforeach()
+endfunction()
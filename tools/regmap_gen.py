@@ -0,0 +1,310 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2009 - 2020 National Aeronautics and Space Administration. All Foreign Rights are Reserved to the U.S. Government.
+#
+# ITC Team
+# NASA IV&V
+# ivv-itc@lists.nasa.gov
+#
+"""Generate a C header of libmem register accessors from a register map description.
+
+The description is JSON, YAML (when PyYAML is installed) or XML:
+
+    {
+      "name": "adc",                  accessor prefix
+      "width": 32,                    default register width in bits (8, 16, 32 or 64)
+      "registers": [
+        {"name": "ctrl", "offset": "0x00", "access": "rw",
+         "fields": [{"name": "enable", "bits": "0"},
+                    {"name": "mode",   "bits": "3:1"}]},
+        {"name": "status", "offset": "0x04", "access": "ro"}
+      ]
+    }
+
+    <regmap name="adc" width="32">
+      <register name="ctrl" offset="0x00" access="rw">
+        <field name="enable" bits="0"/>
+      </register>
+    </regmap>
+
+For each register the header holds the offset, a read and/or write accessor on a
+mem_region_t, and per field the shift, mask, a value macro and get/set accessors.
+Layout errors (overlapping registers or fields, misaligned offsets, fields outside
+the register) and names whose generated symbols collide are rejected here, and the header re-checks its constants with
+static asserts so hand edits fail the build as well.
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+import xml.etree.ElementTree as ET
+
+WIDTHS = (8, 16, 32, 64)
+ACCESS = ("rw", "ro", "wo")
+IDENT = re.compile(r"^[A-Za-z_][A-Za-z0-9_]*$")
+
+
+class RegmapError(Exception):
+    pass
+
+
+def to_int(value, what):
+    if isinstance(value, int):
+        return value
+    try:
+        return int(str(value), 0)
+    except ValueError:
+        raise RegmapError("%s: %r is not an integer" % (what, value))
+
+
+def load(path):
+    ext = os.path.splitext(path)[1].lower()
+    with open(path) as f:
+        if ext in (".yaml", ".yml"):
+            try:
+                import yaml
+            except ImportError:
+                raise RegmapError("%s: PyYAML is not installed, use JSON or XML" % path)
+            return yaml.safe_load(f)
+        if ext == ".xml":
+            return load_xml(ET.parse(f).getroot())
+        return json.load(f)
+
+
+def load_xml(root):
+    spec = dict(root.attrib)
+    spec["registers"] = []
+    for reg in root.findall("register"):
+        entry = dict(reg.attrib)
+        entry["fields"] = [dict(field.attrib) for field in reg.findall("field")]
+        spec["registers"].append(entry)
+    return spec
+
+
+def parse_bits(bits, width, what):
+    parts = str(bits).split(":")
+    if len(parts) == 1:
+        msb = lsb = to_int(parts[0], what)
+    elif len(parts) == 2:
+        msb, lsb = to_int(parts[0], what), to_int(parts[1], what)
+    else:
+        raise RegmapError("%s: bits must be \"n\" or \"msb:lsb\"" % what)
+    if lsb > msb or msb >= width:
+        raise RegmapError("%s: bits %s do not fit a %d-bit register" % (what, bits, width))
+    return lsb, msb - lsb + 1
+
+
+def check_name(name, what):
+    if not isinstance(name, str) or not IDENT.match(name):
+        raise RegmapError("%s: %r is not a valid C identifier" % (what, name))
+    return name
+
+
+def check_symbols(prefix, registers):
+    """Reject names whose generated macros or functions would collide, e.g. a field
+    called "offset" next to the register's _OFFSET macro or a register "regmap" with
+    a field "size" next to <MAP>_REGMAP_SIZE."""
+    up = prefix.upper()
+    seen = {}
+
+    def add(symbol, what):
+        if symbol in seen:
+            raise RegmapError("%s: generated name %s collides with %s" % (what, symbol, seen[symbol]))
+        seen[symbol] = what
+
+    add("%s_REGMAP_SIZE" % up, "the map size")
+    add("%s_regmap_open" % prefix, "the map open function")
+    for reg in registers:
+        what = "register %s" % reg["name"]
+        macro = "%s_%s" % (up, reg["name"].upper())
+        name = "%s_%s" % (prefix, reg["name"])
+        add(macro + "_OFFSET", what)
+        add(name + "_read", what)
+        add(name + "_write", what)
+        for field in reg["fields"]:
+            fwhat = "%s field %s" % (what, field["name"])
+            fmacro = "%s_%s" % (macro, field["name"].upper())
+            add(fmacro, fwhat)
+            add(fmacro + "_SHIFT", fwhat)
+            add(fmacro + "_MASK", fwhat)
+            add("%s_%s_get" % (name, field["name"]), fwhat)
+            add("%s_%s_set" % (name, field["name"]), fwhat)
+
+
+def validate(spec):
+    prefix = check_name(spec.get("name"), "regmap name")
+    default_width = to_int(spec.get("width", 32), "regmap width")
+    registers = []
+    names = set()
+
+    for reg in spec.get("registers", []):
+        name = check_name(reg.get("name"), "register name")
+        what = "register %s" % name
+        if name in names:
+            raise RegmapError("%s: defined twice" % what)
+        names.add(name)
+
+        width = to_int(reg.get("width", default_width), what + " width")
+        if width not in WIDTHS:
+            raise RegmapError("%s: width must be one of %s" % (what, WIDTHS))
+        offset = to_int(reg.get("offset"), what + " offset")
+        if offset % (width // 8):
+            raise RegmapError("%s: offset 0x%X is not %d-bit aligned" % (what, offset, width))
+        access = reg.get("access", "rw")
+        if access not in ACCESS:
+            raise RegmapError("%s: access must be one of %s" % (what, ACCESS))
+
+        fields = []
+        used = 0
+        for field in reg.get("fields", []):
+            fname = check_name(field.get("name"), what + " field name")
+            fwhat = "%s field %s" % (what, fname)
+            shift, size = parse_bits(field.get("bits"), width, fwhat)
+            mask = ((1 << size) - 1) << shift
+            if used & mask:
+                raise RegmapError("%s: overlaps another field" % fwhat)
+            used |= mask
+            fields.append({"name": fname, "shift": shift, "mask": mask})
+
+        registers.append({"name": name, "offset": offset, "width": width, "access": access, "fields": fields})
+
+    check_symbols(prefix, registers)
+
+    registers.sort(key=lambda r: r["offset"])
+    for prev, reg in zip(registers, registers[1:]):
+        if prev["offset"] + prev["width"] // 8 > reg["offset"]:
+            raise RegmapError("register %s overlaps register %s" % (reg["name"], prev["name"]))
+
+    return prefix, registers
+
+
+def generate(prefix, registers, source):
+    guard = "_%s_regs_h_" % prefix.lower()
+    up = prefix.upper()
+    size = max([r["offset"] + r["width"] // 8 for r in registers] or [0])
+    out = []
+    w = out.append
+
+    w("/* Generated by tools/regmap_gen.py from %s, do not edit */" % os.path.basename(source))
+    w("")
+    w("#ifndef %s" % guard)
+    w("#define %s" % guard)
+    w("")
+    w("#include \"libmem.h\"")
+    w("")
+    w("#ifndef REGMAP_STATIC_ASSERT")
+    w("#if defined(__cplusplus)")
+    w("#define REGMAP_STATIC_ASSERT static_assert")
+    w("#elif defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L)")
+    w("#define REGMAP_STATIC_ASSERT _Static_assert")
+    w("#else")
+    w("/* C99, a negative array size fails the build */")
+    w("#ifdef __COUNTER__")
+    w("#define REGMAP_ASSERT_ID __COUNTER__")
+    w("#else")
+    w("#define REGMAP_ASSERT_ID __LINE__")
+    w("#endif")
+    w("#define REGMAP_ASSERT_CAT_(a, b) a##b")
+    w("#define REGMAP_ASSERT_CAT(a, b) REGMAP_ASSERT_CAT_(a, b)")
+    w("#define REGMAP_STATIC_ASSERT(cond, msg) typedef char REGMAP_ASSERT_CAT(regmap_static_assert_, REGMAP_ASSERT_ID)[(cond) ? 1 : -1]")
+    w("#endif")
+    w("#endif")
+    w("")
+    w("#ifdef __cplusplus")
+    w("extern \"C\" {")
+    w("#endif")
+    w("")
+    w("#define %s_REGMAP_SIZE 0x%Xu" % (up, size))
+    w("")
+    w("/* Map the register block at `base` */")
+    w("static inline int32_t %s_regmap_open(uint32_t base, mem_region_t* region)" % prefix)
+    w("{")
+    w("    return mem_region_open(base, %s_REGMAP_SIZE, region);" % up)
+    w("}")
+
+    for reg in registers:
+        name = "%s_%s" % (prefix, reg["name"])
+        macro = name.upper()
+        ctype = "uint%d_t" % reg["width"]
+        suffix = "ULL" if reg["width"] == 64 else "u"
+        w("")
+        w("/* %s, %s */" % (reg["name"], reg["access"]))
+        w("#define %s_OFFSET 0x%Xu" % (macro, reg["offset"]))
+        w("REGMAP_STATIC_ASSERT((%s_OFFSET %% sizeof(%s)) == 0, \"%s is misaligned\");" % (macro, ctype, reg["name"]))
+        w("REGMAP_STATIC_ASSERT((%s_OFFSET + sizeof(%s)) <= %s_REGMAP_SIZE, \"%s is outside the map\");" % (macro, ctype, up, reg["name"]))
+
+        for field in reg["fields"]:
+            fmacro = "%s_%s" % (macro, field["name"].upper())
+            w("#define %s_SHIFT %d" % (fmacro, field["shift"]))
+            w("#define %s_MASK  0x%X%s" % (fmacro, field["mask"], suffix))
+            w("#define %s(v)    ((((%s) (v)) << %s_SHIFT) & %s_MASK)" % (fmacro, ctype, fmacro, fmacro))
+            w("REGMAP_STATIC_ASSERT((%s_MASK >> %s_SHIFT) != 0, \"%s.%s is empty\");" % (fmacro, fmacro, reg["name"], field["name"]))
+
+        if reg["access"] != "wo":
+            w("static inline %s %s_read(const mem_region_t* region)" % (ctype, name))
+            w("{")
+            w("    return mem_region_read%d(region, %s_OFFSET);" % (reg["width"], macro))
+            w("}")
+        if reg["access"] != "ro":
+            w("static inline void %s_write(const mem_region_t* region, %s value)" % (name, ctype))
+            w("{")
+            w("    mem_region_write%d(region, %s_OFFSET, value);" % (reg["width"], macro))
+            w("}")
+
+        for field in reg["fields"]:
+            fname = "%s_%s" % (name, field["name"])
+            fmacro = fname.upper()
+            if reg["access"] != "wo":
+                w("static inline %s %s_get(const mem_region_t* region)" % (ctype, fname))
+                w("{")
+                w("    return (%s_read(region) & %s_MASK) >> %s_SHIFT;" % (name, fmacro, fmacro))
+                w("}")
+            if reg["access"] == "rw":
+                w("static inline void %s_set(const mem_region_t* region, %s value)" % (fname, ctype))
+                w("{")
+                w("    %s_write(region, (%s_read(region) & ~%s_MASK) | %s(value));" % (name, name, fmacro, fmacro))
+                w("}")
+
+    w("")
+    w("#ifdef __cplusplus")
+    w("}")
+    w("#endif")
+    w("")
+    w("#endif")
+    return "\n".join(out) + "\n"
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate libmem register accessors from a register map")
+    parser.add_argument("spec", help="register map description (.json, .yaml/.yml or .xml)")
+    parser.add_argument("-o", "--output", help="header to write, default <name>_regs.h next to the spec")
+    parser.add_argument("--print-name", action="store_true", help="print the regmap name and exit, used by hwlib_regmap.cmake")
+    args = parser.parse_args()
+
+    try:
+        prefix, registers = validate(load(args.spec))
+    except (RegmapError, ET.ParseError, ValueError) as err:
+        sys.stderr.write("regmap_gen: %s: %s\n" % (args.spec, err))
+        return 1
+
+    if args.print_name:
+        sys.stdout.write(prefix)
+        return 0
+
+    output = args.output or os.path.join(os.path.dirname(args.spec), "%s_regs.h" % prefix)
+    header = generate(prefix, registers, args.spec)
+
+    # leave an unchanged header alone so dependents are not rebuilt
+    if os.path.exists(output):
+        with open(output) as f:
+            if f.read() == header:
+                return 0
+    with open(output, "w") as f:
+        f.write(header)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())